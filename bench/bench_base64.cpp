@@ -0,0 +1,85 @@
+/**
+ * Benchmarks for vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+// Measures base64 throughput of binary properties: encoding by TextWriter
+// and decoding of folded PHOTO values read by TextBufferReader.
+// Usage: vCard_bench_base64 [photo size in KB] [photos count]
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include "text_io.h"
+#include "vcard_blob.h"
+#include "bench_utils.h"
+
+int main(int argc, char **argv)
+{
+    size_t size = (argc > 1 ? std::atoi(argv[1]) : 200) * 1024;
+    int count = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    std::string data(size, '\0');
+    for(size_t i = 0; i < size; i++)
+        data[i] = static_cast<char>(i * 2654435761u >> 13);
+
+    std::vector<vCard> cards(count);
+    for(vCard& card : cards){
+        card << vCardProperty(VC_FORMATTED_NAME, "John Doe");
+        card << vCardProperty::createBinary(VC_PHOTO, data, "JPEG");
+    }
+    std::printf("%d cards with %zu KB photos\n", count, size / 1024);
+
+    auto text = std::make_shared<std::string>();
+    {
+        BenchTimer t;
+        std::ostringstream os;
+        TextWriter tw(os);
+        tw << cards;
+        *text = os.str();
+        report("TextWriter (base64 encode)", t.seconds(), count, size * count);
+    }
+
+    // folded by 76 octets as in real exports
+    auto folded = std::make_shared<std::string>();
+    folded->reserve(text->size() * 78 / 76);
+    size_t pos = 0;
+    while(pos < text->size()){
+        size_t eol = text->find("\r\n", pos);
+        for(size_t i = pos; i < eol; i += 75)
+            *folded += (i != pos ? "\r\n " : "") + text->substr(i, std::min<size_t>(75, eol - i));
+        *folded += "\r\n";
+        pos = eol + 2;
+    }
+
+    std::vector<vCard> parsed;
+    {
+        BenchTimer t;
+        parsed = TextBufferReader(std::shared_ptr<const std::string>(folded)).parseCards();
+        report("TextBufferReader (lazy blobs)", t.seconds(), parsed.size(), folded->size());
+    }
+
+    {
+        BenchTimer t;
+        size_t total = 0;
+        for(vCard& card : parsed)
+            total += card[VC_PHOTO].getBinary().size();
+        report("getBinary (base64 decode)", t.seconds(), parsed.size(), total);
+        if(total != size * count)
+            return 1;
+    }
+
+    return 0;
+}
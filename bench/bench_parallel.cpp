@@ -0,0 +1,53 @@
+/**
+ * Benchmarks for vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Scaling of parallel parsing: cards per second for 1, 2, 4, 8 ... N threads
+// Usage: vCard_bench_parallel [cards count] [max threads]
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include "text_io.h"
+#include "bench_utils.h"
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 200000;
+    unsigned max_threads = argc > 2 ? std::atoi(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+
+    std::string data = generateCards(count);
+    std::printf("%d cards, %.1f MB, %u hardware threads\n", count, data.size() / (1024.0 * 1024.0),
+                std::thread::hardware_concurrency());
+
+    for(unsigned threads = 1; ; threads *= 2){
+        threads = std::min(threads, max_threads);
+
+        BenchTimer t;
+        TextBufferReader br(data);
+        std::vector<vCard> cards = br.parseCards(threads);
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "parseCards(%u)", threads);
+        report(name, t.seconds(), cards.size(), data.size());
+
+        if(threads == max_threads)
+            break;
+    }
+
+    return 0;
+}
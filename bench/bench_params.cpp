@@ -0,0 +1,153 @@
+/**
+ * Benchmarks for vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+// Compares vCardParamMap (flat array with inline storage) with std::multimap<std::string, std::string>
+// on the parameter counts seen in address book exports: most properties have no parameters,
+// TEL, EMAIL and ADR have one to three TYPE parameters, a few have more.
+// Usage: vCard_bench_params [properties count]
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include "vcard.h"
+#include "bench_utils.h"
+
+// Heap usage counters, the benchmark is single threaded
+static size_t g_allocations = 0;
+static size_t g_bytes = 0;
+
+void* operator new(size_t size)
+{
+    g_allocations++;
+    g_bytes += size;
+    if(void *p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+struct Param {
+    const char *name;
+    const char *value;
+};
+
+// Parameter lists of one property, generated once, so both containers get the same input
+typedef std::vector<Param> ParamList;
+
+std::vector<ParamList> generateParams(size_t count)
+{
+    static const Param tel[] = {{"TYPE", "CELL"}, {"TYPE", "VOICE"}, {"TYPE", "pref"}, {"PREF", "1"}, {"VALUE", "uri"}};
+    static const Param other[] = {{"TYPE", "HOME"}, {"CHARSET", "UTF-8"}, {"ENCODING", "QUOTED-PRINTABLE"},
+                                  {"LABEL", "42 Plantation St.\\nBaytown\\, LA 30314"}, {"LANGUAGE", "en"}};
+
+    std::vector<ParamList> result(count);
+    uint32_t seed = 12345;
+    for(ParamList& list : result){
+        seed = seed * 1103515245 + 12345;
+        unsigned r = (seed >> 16) % 100;
+        // 45% none, 25% one, 20% two, 8% three, 2% five
+        size_t n = r < 45 ? 0 : r < 70 ? 1 : r < 90 ? 2 : r < 98 ? 3 : 5;
+        const Param *source = (r & 1) ? tel : other;
+        for(size_t i = 0; i < n; i++)
+            list.push_back(source[i]);
+    }
+    return result;
+}
+
+struct Result {
+    double build, lookup, iterate;
+    size_t bytes, allocations;
+    size_t checksum;
+};
+
+template<class Map, class Add, class Count, class First>
+Result run(const std::vector<ParamList>& input, Add add, Count count, First first)
+{
+    Result r;
+    std::vector<Map> maps(input.size());
+    size_t allocations = g_allocations, bytes = g_bytes;
+
+    BenchTimer t;
+    for(size_t i = 0; i < input.size(); i++)
+        for(const Param& p : input[i])
+            add(maps[i], p.name, p.value);
+    r.build = t.seconds();
+    r.allocations = g_allocations - allocations;
+    // the object itself is a part of vCardProperty, count it too
+    r.bytes = g_bytes - bytes + sizeof(Map) * maps.size();
+
+    size_t checksum = 0;
+    BenchTimer lookup;
+    for(Map& m : maps){
+        checksum += count(m, "TYPE");
+        checksum += first(m, "PREF");
+    }
+    r.lookup = lookup.seconds();
+
+    BenchTimer iterate;
+    for(Map& m : maps)
+        for(auto it = m.begin(); it != m.end(); ++it)
+            checksum += it->second.size();
+    r.iterate = iterate.seconds();
+
+    r.checksum = checksum;
+    return r;
+}
+
+void print(const char *name, const Result& r, size_t count)
+{
+    std::printf("%-30s build %7.1f ns  lookup %6.1f ns  iterate %6.1f ns  %6.1f bytes %5.2f allocs  (%zu)\n",
+                name, r.build * 1e9 / count, r.lookup * 1e9 / count, r.iterate * 1e9 / count,
+                double(r.bytes) / count, double(r.allocations) / count, r.checksum);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    std::vector<ParamList> input = generateParams(count);
+    std::printf("%zu properties, per property:\n", count);
+
+    typedef std::multimap<std::string, std::string> MultiMap;
+    Result multimap = run<MultiMap>(input,
+        [](MultiMap& m, const char *name, const char *value){ m.insert({name, value}); },
+        [](MultiMap& m, const char *name){ return m.count(name); },
+        [](MultiMap& m, const char *name){
+            auto it = m.find(name);
+            return it != m.end() ? it->second.size() : 0;
+        });
+    print("std::multimap<string, string>", multimap, count);
+
+    Result flat = run<vCardParamMap>(input,
+        [](vCardParamMap& m, const char *name, const char *value){ m.addParam(name, value); },
+        [](vCardParamMap& m, const char *name){ return size_t(m.count(name)); },
+        [](vCardParamMap& m, const char *name){
+            auto range = m.getParams(name);
+            return range.first != range.second ? range.first->second.size() : 0;
+        });
+    print("vCardParamMap", flat, count);
+
+    return multimap.checksum == flat.checksum ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+/**
+ * Benchmarks for vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Compares stream parsing (TextReader) with zero-copy buffer parsing (TextBufferReader)
+// and reading of the file through std::ifstream with memory mapped file.
+// Usage: vCard_bench_parse [cards count]
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "text_io.h"
+#include "vcard_batch.h"
+#include "bench_utils.h"
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+    std::string data = generateCards(count);
+    std::printf("%d cards, %.1f MB\n", count, data.size() / (1024.0 * 1024.0));
+
+    {
+        std::istringstream is(data);
+        BenchTimer t;
+        TextReader tr(is);
+        std::vector<vCard> cards = tr.parseCards();
+        report("TextReader::parseCards", t.seconds(), cards.size(), data.size());
+    }
+
+    {
+        BenchTimer t;
+        TextBufferReader br(data);
+        std::vector<vCard> cards = br.parseCards();
+        report("TextBufferReader::parseCards", t.seconds(), cards.size(), data.size());
+    }
+
+    {
+        BenchTimer t;
+        TextBufferReader br(data);
+        vCardBatch batch;
+        size_t cards = br.readBatch(batch);
+        batch.clear();
+        report("TextBufferReader::readBatch", t.seconds(), cards, data.size());
+    }
+
+    {
+        // views only, no vCardProperty objects are created
+        BenchTimer t;
+        TextBufferReader br(data);
+        vCardStringRef line;
+        vCardPropertyRef prop;
+        size_t cards = 0, properties = 0;
+        while(br.readLine(line)){
+            if(line == VC_END_TOKEN)
+                cards++;
+            else if(line != VC_BEGIN_TOKEN){
+                TextReader::parseProperty(line, prop);
+                properties += prop.params().size() + 1;
+            }
+        }
+        report("TextBufferReader views", t.seconds(), cards, data.size());
+    }
+
+    {
+        // event callbacks, the values are split but nothing is materialized
+        struct Counter : vCardHandler {
+            size_t emails = 0;
+            void onProperty(vCardStringRef, vCardStringRef name, const std::vector<vCardParamRef>&,
+                            const std::vector<vCardStringRef>&) override { emails += name == VC_EMAIL; }
+        };
+
+        BenchTimer t;
+        Counter counter;
+        size_t cards = TextBufferReader(data).parse(counter);
+        report("TextBufferReader::parse(handler)", t.seconds(), cards, data.size());
+    }
+
+    {
+        BenchTimer t;
+        TextBufferReader br(data);
+        br.setProjection({VC_FORMATTED_NAME, VC_EMAIL, VC_TELEPHONE, "UID"});
+        std::vector<vCard> cards = br.parseCards();
+        report("TextBufferReader projection", t.seconds(), cards.size(), data.size());
+    }
+
+    const char *path = "bench_parse.vcf";
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        ofs << data;
+    }
+
+    {
+        std::ifstream ifs(path, std::ios::binary);
+        BenchTimer t;
+        TextReader tr(ifs);
+        std::vector<vCard> cards = tr.parseCards();
+        report("TextReader(std::ifstream)", t.seconds(), cards.size(), data.size());
+    }
+
+    {
+        BenchTimer t;
+        TextBufferReader br(std::make_shared<vCardMappedFile>(path));
+        std::vector<vCard> cards = br.parseCards();
+        report("TextBufferReader(mapped file)", t.seconds(), cards.size(), data.size());
+    }
+
+    std::remove(path);
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * Benchmarks for vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VCARD_BENCH_UTILS_H
+#define VCARD_BENCH_UTILS_H
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Generates .vcf text with `count` cards similar to address book exports
+static inline std::string generateCards(int count)
+{
+    std::string s;
+    s.reserve(count * 400);
+    for(int i = 0; i < count; i++){
+        std::string n = std::to_string(i);
+        s += "BEGIN:VCARD\r\n"
+             "VERSION:3.0\r\n"
+             "N:Doe" + n + ";John;;Mr.;\r\n"
+             "FN:John Doe " + n + "\r\n"
+             "ORG:Example Inc.;Research and development\r\n"
+             "item1.EMAIL;TYPE=INTERNET;TYPE=HOME;TYPE=pref:john" + n + "@example.com\r\n"
+             "TEL;TYPE=CELL;TYPE=VOICE;TYPE=pref:+1 555 01" + n + "\r\n"
+             "TEL;TYPE=WORK:+1 555 02" + n + "\r\n"
+             "ADR;TYPE=HOME;LABEL=\"42 Plantation St.\\nBaytown\\, LA 30314\":;;42 Plantation St.;Baytown;LA;30314;USA\r\n"
+             "NOTE:Lorem ipsum dolor sit amet\\, consectetur adipiscing elit\\, sed do eiusmod tempor incididunt\r\n"
+             " ut labore et dolore magna aliqua.\r\n"
+             "UID:urn:uuid:4fbe8971-0bc3-424c-9c26-" + n + "\r\n"
+             "END:VCARD\r\n";
+    }
+    return s;
+}
+
+class BenchTimer {
+public:
+    BenchTimer(): m_start(std::chrono::steady_clock::now()) {}
+
+    double seconds() const
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    }
+
+protected:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+static inline void report(const char *name, double seconds, size_t cards, size_t bytes)
+{
+    std::printf("%-32s %8.3f s %12.0f cards/s %9.1f MB/s\n", name, seconds,
+                cards / seconds, bytes / seconds / (1024 * 1024));
+}
+
+#endif //VCARD_BENCH_UTILS_H
@@ -0,0 +1,99 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+// Compares typed accessors of vCardProperty with the usual consumer code (std::stod over the
+// split GEO value, sscanf over BDAY) for jobs which read the same fields several times.
+// Usage: vCard_bench_values [properties count] [reads per property]
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "vcard.h"
+#include "bench_utils.h"
+
+namespace {
+
+std::vector<vCardProperty> generateProperties(const char *name, size_t count, bool dates)
+{
+    std::vector<vCardProperty> result;
+    result.reserve(count);
+    uint32_t seed = 12345;
+    char buffer[64];
+    for(size_t i = 0; i < count; i++){
+        seed = seed * 1103515245 + 12345;
+        if(dates)
+            std::snprintf(buffer, sizeof(buffer), "%04u-%02u-%02u", 1940 + (seed >> 8) % 70, 1 + (seed >> 4) % 12, 1 + seed % 28);
+        else
+            std::snprintf(buffer, sizeof(buffer), "%.6f;%.6f", ((seed >> 8) % 180000) / 1000.0 - 90,
+                          ((seed >> 4) % 360000) / 1000.0 - 180);
+        result.push_back(vCardProperty(name, buffer));
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t count = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    int reads = argc > 2 ? std::atoi(argv[2]) : 3;
+    std::printf("%zu properties, %d reads:\n", count, reads);
+
+    std::vector<vCardProperty> geo = generateProperties(VC_GEOGRAPHIC_POSITION, count, false);
+    double sum_stod = 0, sum_typed = 0;
+    BenchTimer stod;
+    for(int r = 0; r < reads; r++)
+        for(vCardProperty& p : geo){
+            std::vector<std::string>& v = p.values();
+            sum_stod += std::stod(v[0]) + std::stod(v[1]);
+        }
+    double stod_time = stod.seconds();
+
+    BenchTimer typed;
+    for(int r = 0; r < reads; r++)
+        for(vCardProperty& p : geo){
+            const vCardGeoPosition& g = p.geoPosition();
+            sum_typed += g.latitude + g.longitude;
+        }
+    double typed_time = typed.seconds();
+    std::printf("%-32s %7.1f ns\n%-32s %7.1f ns\n", "GEO std::stod", stod_time * 1e9 / (count * reads),
+                "GEO geoPosition()", typed_time * 1e9 / (count * reads));
+
+    std::vector<vCardProperty> bday = generateProperties(VC_BIRTHDAY, count, true);
+    long years_scanf = 0, years_typed = 0;
+    BenchTimer scan;
+    for(int r = 0; r < reads; r++)
+        for(vCardProperty& p : bday){
+            int y = 0, m = 0, d = 0;
+            if(std::sscanf(p.getValue().c_str(), "%d-%d-%d", &y, &m, &d) == 3)
+                years_scanf += y + m + d;
+        }
+    double scan_time = scan.seconds();
+
+    BenchTimer date;
+    for(int r = 0; r < reads; r++)
+        for(vCardProperty& p : bday){
+            const vCardDateTime& d = p.dateTime();
+            years_typed += d.year + d.month + d.day;
+        }
+    double date_time = date.seconds();
+    std::printf("%-32s %7.1f ns\n%-32s %7.1f ns\n", "BDAY sscanf", scan_time * 1e9 / (count * reads),
+                "BDAY dateTime()", date_time * 1e9 / (count * reads));
+
+    return sum_stod == sum_typed && years_scanf == years_typed ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+// Measures TextWriter throughput on cards similar to address book exports.
+// Usage: vCard_bench_write [cards count]
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "vcard.h"
+#include "text_io.h"
+#include "json_io.h"
+#include "bench_utils.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? std::atoi(argv[1]) : 100000;
+    std::string data = generateCards(count);
+    std::vector<vCard> cards = TextBufferReader(data).parseCards();
+    std::printf("%zu cards\n", cards.size());
+
+    size_t size;
+    {
+        BenchTimer t;
+        std::ostringstream os;
+        TextWriter(os) << cards;
+        size = os.str().size();
+        report("TextWriter(std::ostringstream)", t.seconds(), cards.size(), size);
+    }
+    {
+        BenchTimer t;
+        std::ostringstream os;
+        TextWriter tw(os);
+        for(vCard& card : cards)
+            tw << card;
+        report("TextWriter card by card", t.seconds(), cards.size(), size);
+    }
+    {
+        BenchTimer t;
+        std::ofstream os("/dev/null", std::ios::binary);
+        TextWriter(os) << cards;
+        report("TextWriter(std::ofstream)", t.seconds(), cards.size(), size);
+    }
+
+    {
+        BenchTimer t;
+        std::string out;
+        vCardStringSink sink(out);
+        TextWriter(sink) << cards;
+        report("TextWriter(vCardStringSink)", t.seconds(), cards.size(), out.size());
+    }
+#ifndef _WIN32
+    {
+        int fd = open("/dev/null", O_WRONLY);
+        BenchTimer t;
+        {
+            vCardFdSink sink(fd);
+            TextWriter(sink) << cards;
+        }
+        report("TextWriter(vCardFdSink)", t.seconds(), cards.size(), size);
+        close(fd);
+    }
+    {
+        int fd = open("/dev/null", O_WRONLY);
+        BenchTimer t;
+        {
+            vCardFdSink sink(fd);
+            TextWriter(sink).write(cards, 0);
+        }
+        report("TextWriter::write(all cores)", t.seconds(), cards.size(), size);
+        close(fd);
+    }
+#endif
+    {
+        BenchTimer t;
+        std::ostringstream os;
+        JsonWriter(os) << cards;
+        report("JsonWriter(std::ostringstream)", t.seconds(), cards.size(), os.str().size());
+    }
+    {
+        BenchTimer t;
+        std::string out;
+        vCardStringSink sink(out);
+        JsonWriter(sink) << cards;
+        report("JsonWriter(vCardStringSink)", t.seconds(), cards.size(), out.size());
+    }
+
+    {
+        BenchTimer t;
+        std::string out;
+        vCardStringSink sink(out);
+        JsonWriter(sink).write(cards, 0);
+        report("JsonWriter::write(all cores)", t.seconds(), cards.size(), out.size());
+    }
+
+    return 0;
+}
@@ -20,11 +20,23 @@
 #define VCARD_JSON_IO_H
 
 #include <istream>
+#include <memory>
 #include "vcard.h"
+#include "output_sink.h"
 
+/**
+ * @brief jCard (RFC 7095) writer. Text values are unescaped and written as JSON strings,
+ * structured values (N, ADR, ORG, GENDER) as arrays of components, inline binary values
+ * of vCard 3.0 as "data:" URIs.
+ */
 class JsonWriter {
 public:
-    JsonWriter(std::ostream& os /*, vCvCardEncoding code = UTF_8*/): m_os(&os) {}
+    JsonWriter(std::ostream& os /*, vCvCardEncoding code = UTF_8*/);
+
+    /**
+     * The sink gets the output by blocks, so flush() it after writing
+     */
+    explicit JsonWriter(vCardOutputSink& sink): m_sink(&sink) {}
     ~JsonWriter() {}
 
     JsonWriter & operator << (vCard & vCard);
@@ -32,10 +44,31 @@ public:
     JsonWriter & operator << (vCardProperty & prop);
     JsonWriter & operator << (vCardParamMap & param);
 
+    /**
+     * Writes the cards formatted on `threads` threads (0 - number of cores), the output is the
+     * same as of operator << (std::vector<vCard>&)
+     */
+    JsonWriter & write(std::vector<vCard> & cards, unsigned threads);
+
 protected:
-    std::ostream *m_os;
+    void writeCards(std::vector<vCard>& cards, size_t begin, size_t end);
+    void writeCard(vCard& card);
+    void writeProperty(vCardProperty& prop);
+    /**
+     * @param group The group of the property, written as "group" parameter
+     * @param binary ENCODING and TYPE parameters are a part of the "data:" URI value
+     */
+    void writeParams(vCardParamMap& params, const std::string& group, bool binary);
+
+    /**
+     * Flushes the stream sink, other sinks are flushed only when their block is filled
+     */
+    void finishOutput();
 
-    std::string get_property_type(std::string property_name);
+    vCardOutputSink *m_sink;
+    std::unique_ptr<vCardOutputSink> m_ownSink;     // sink of the stream
+    std::vector<vCardStringRef> m_components;       // split structured value
+    std::vector<vCardStringRef> m_items;            // split list value or component
 };
 
 class JsonReader {
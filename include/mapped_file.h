@@ -0,0 +1,56 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VCARD_MAPPED_FILE_H
+#define VCARD_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Read-only memory mapping of the whole file (POSIX mmap, MapViewOfFile on Windows).
+ * Pages are loaded by the kernel on demand, so files larger than RAM can be mapped.
+ */
+class vCardMappedFile {
+public:
+    /**
+     * Maps the file and hints the kernel that it will be read sequentially
+     * @throws std::runtime_error Is thrown if the file can not be opened or mapped
+     */
+    explicit vCardMappedFile(const std::string& path);
+    ~vCardMappedFile();
+
+    vCardMappedFile(const vCardMappedFile&) = delete;
+    vCardMappedFile& operator = (const vCardMappedFile&) = delete;
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    /**
+     * Tells the kernel that pages of the range are not needed anymore.
+     * The memory stays valid, pages are read from the file again on the next access.
+     * Does nothing on Windows.
+     */
+    void release(size_t offset, size_t length) const;
+
+protected:
+    const char *m_data;
+    size_t m_size;
+};
+
+#endif //VCARD_MAPPED_FILE_H
@@ -0,0 +1,188 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VCARD_OUTPUT_SINK_H
+#define VCARD_OUTPUT_SINK_H
+
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include "string_ref.h"
+
+struct iovec;
+
+/**
+ * @brief Destination of the writers output. The writers append to the contiguous buffer
+ * of the sink, the sink passes the buffered output on by large blocks, so there are no
+ * per-token stream calls.
+ * Output left in the buffer is passed on by flush() or by the destructor of the sink.
+ */
+class vCardOutputSink {
+public:
+    virtual ~vCardOutputSink() {}
+
+    vCardOutputSink(const vCardOutputSink&) = delete;
+    vCardOutputSink& operator = (const vCardOutputSink&) = delete;
+
+    void write(const char *data, size_t size)
+    {
+        if(size < m_blockSize)
+            m_buffer->append(data, size);
+        else
+            writeLarge(data, size);
+    }
+
+    vCardOutputSink& operator << (char c) { *m_buffer += c; return *this; }
+    vCardOutputSink& operator << (const char *s) { write(s, std::strlen(s)); return *this; }
+    vCardOutputSink& operator << (const std::string& s) { write(s.data(), s.size()); return *this; }
+    vCardOutputSink& operator << (vCardStringRef s) { write(s.data(), s.size()); return *this; }
+
+    /**
+     * The buffer, writers may append to it and change the not flushed output directly
+     */
+    std::string& buffer() { return *m_buffer; }
+
+    /**
+     * Passes the buffered output on if the block is filled, called by the writers between cards
+     */
+    void commit()
+    {
+        if(m_buffer->size() >= m_blockSize)
+            flush();
+    }
+
+    /**
+     * Passes all buffered output on
+     */
+    virtual void flush() = 0;
+
+protected:
+    vCardOutputSink(std::string *buffer, size_t block_size): m_buffer(buffer), m_blockSize(block_size) {}
+
+    /**
+     * Writes data not smaller than the block, the buffered output goes first.
+     * Default implementation appends the data to the buffer and flushes it.
+     */
+    virtual void writeLarge(const char *data, size_t size);
+
+    std::string *m_buffer;
+    size_t m_blockSize;
+};
+
+/**
+ * @brief Collects the output in a string, the string is the buffer itself
+ */
+class vCardStringSink : public vCardOutputSink {
+public:
+    /**
+     * @param out The output is appended to it
+     */
+    explicit vCardStringSink(std::string& out): vCardOutputSink(&out, std::string::npos) {}
+    vCardStringSink(): vCardOutputSink(&m_own, std::string::npos) {}
+
+    const std::string& str() const { return *m_buffer; }
+
+    void flush() override {}
+
+protected:
+    std::string m_own;
+};
+
+/**
+ * @brief Writes the output to std::ostream by blocks
+ */
+class vCardStreamSink : public vCardOutputSink {
+public:
+    static const size_t DEFAULT_BLOCK = 64 * 1024;
+
+    explicit vCardStreamSink(std::ostream& os, size_t block_size = DEFAULT_BLOCK);
+    ~vCardStreamSink();
+
+    void flush() override;
+
+protected:
+    void writeLarge(const char *data, size_t size) override;
+
+    std::ostream *m_os;
+    std::string m_own;
+};
+
+/**
+ * @brief Writes the output to the file descriptor (file, pipe, socket) with write()/writev()
+ * (_write() on Windows) by large blocks, interrupted and partial writes are continued.
+ * The descriptor is not closed.
+ */
+class vCardFdSink : public vCardOutputSink {
+public:
+    static const size_t DEFAULT_BLOCK = 256 * 1024;
+
+    explicit vCardFdSink(int fd, size_t block_size = DEFAULT_BLOCK);
+
+    /**
+     * Flushes the output, errors are ignored here, call flush() to get them
+     */
+    ~vCardFdSink();
+
+    /**
+     * @throws std::runtime_error Is thrown if the write fails
+     */
+    void flush() override;
+
+protected:
+    /**
+     * The buffer and the data are written by one writev() call, the data is not copied
+     */
+    void writeLarge(const char *data, size_t size) override;
+
+    /**
+     * Writes the parts and clears the buffer
+     */
+    void writeParts(struct iovec *parts, int count);
+
+    int m_fd;
+    std::string m_own;
+};
+
+/**
+ * @brief Passes the output to the callback by chunks, e.g. to send it as HTTP chunked response
+ */
+class vCardCallbackSink : public vCardOutputSink {
+public:
+    typedef std::function<void(const char *data, size_t size)> Callback;
+
+    static const size_t DEFAULT_BLOCK = 16 * 1024;
+
+    explicit vCardCallbackSink(Callback callback, size_t block_size = DEFAULT_BLOCK);
+
+    /**
+     * Passes the rest of the output, exceptions of the callback are not propagated here
+     */
+    ~vCardCallbackSink();
+
+    void flush() override;
+
+protected:
+    void writeLarge(const char *data, size_t size) override;
+
+    Callback m_callback;
+    std::string m_own;
+};
+
+#endif //VCARD_OUTPUT_SINK_H
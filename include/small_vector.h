@@ -0,0 +1,205 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VCARD_SMALL_VECTOR_H
+#define VCARD_SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+/**
+ * @brief Vector with inline storage for the first N elements.
+ * Up to N elements live inside the object, so no heap allocation is made;
+ * larger sizes move to the heap with the usual doubling growth.
+ * Iterators are plain pointers and are invalidated by any insertion or erase.
+ */
+template<class T, size_t N>
+class vCardSmallVector {
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    vCardSmallVector(): m_data(inlineData()), m_size(0), m_capacity(N) {}
+
+    vCardSmallVector(const vCardSmallVector& v): vCardSmallVector()
+    {
+        reserve(v.m_size);
+        std::uninitialized_copy(v.begin(), v.end(), m_data);
+        m_size = v.m_size;
+    }
+
+    vCardSmallVector(vCardSmallVector&& v) noexcept: vCardSmallVector()
+    {
+        steal(v);
+    }
+
+    ~vCardSmallVector()
+    {
+        clear();
+        if(!isInline())
+            ::operator delete(m_data);
+    }
+
+    vCardSmallVector& operator = (const vCardSmallVector& v)
+    {
+        if(this != &v){
+            clear();
+            reserve(v.m_size);
+            std::uninitialized_copy(v.begin(), v.end(), m_data);
+            m_size = v.m_size;
+        }
+        return *this;
+    }
+
+    vCardSmallVector& operator = (vCardSmallVector&& v) noexcept
+    {
+        if(this != &v){
+            clear();
+            if(!isInline())
+                ::operator delete(m_data);
+            m_data = inlineData();
+            m_capacity = N;
+            steal(v);
+        }
+        return *this;
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t capacity() const { return m_capacity; }
+
+    iterator begin() { return m_data; }
+    iterator end() { return m_data + m_size; }
+    const_iterator begin() const { return m_data; }
+    const_iterator end() const { return m_data + m_size; }
+
+    T& operator[] (size_t i) { return m_data[i]; }
+    const T& operator[] (size_t i) const { return m_data[i]; }
+
+    T& back() { return m_data[m_size - 1]; }
+
+    void reserve(size_t n)
+    {
+        if(n > m_capacity)
+            grow(n);
+    }
+
+    void clear()
+    {
+        destroy(m_data, m_data + m_size);
+        m_size = 0;
+    }
+
+    void push_back(T value)
+    {
+        if(m_size == m_capacity)
+            grow(m_capacity * 2);
+        new(m_data + m_size) T(std::move(value));
+        m_size++;
+    }
+
+    /**
+     * Inserts the value before pos, following elements are shifted
+     * @return iterator to the inserted element
+     */
+    iterator insert(const_iterator pos, T value)
+    {
+        size_t index = pos - m_data;
+        if(m_size == m_capacity)
+            grow(m_capacity * 2);
+
+        if(index == m_size){
+            new(m_data + m_size) T(std::move(value));
+        } else {
+            new(m_data + m_size) T(std::move(m_data[m_size - 1]));
+            std::move_backward(m_data + index, m_data + m_size - 1, m_data + m_size);
+            m_data[index] = std::move(value);
+        }
+        m_size++;
+        return m_data + index;
+    }
+
+    /**
+     * Removes [first, last), following elements are shifted
+     * @return iterator to the element after the removed range
+     */
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        iterator b = const_cast<iterator>(first), e = const_cast<iterator>(last);
+        if(b != e){
+            iterator new_end = std::move(e, end(), b);
+            destroy(new_end, end());
+            m_size -= e - b;
+        }
+        return b;
+    }
+
+    iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+protected:
+    T* inlineData() { return reinterpret_cast<T*>(&m_inline); }
+    bool isInline() const { return m_data == reinterpret_cast<const T*>(&m_inline); }
+
+    static void destroy(T *first, T *last)
+    {
+        for(; first != last; ++first)
+            first->~T();
+    }
+
+    void grow(size_t n)
+    {
+        T *data = static_cast<T*>(::operator new(n * sizeof(T)));
+        std::uninitialized_copy(std::make_move_iterator(m_data), std::make_move_iterator(m_data + m_size), data);
+        destroy(m_data, m_data + m_size);
+        if(!isInline())
+            ::operator delete(m_data);
+        m_data = data;
+        m_capacity = static_cast<uint32_t>(n);
+    }
+
+    // Expects this to be empty and inline
+    void steal(vCardSmallVector& v)
+    {
+        if(v.isInline()){
+            std::uninitialized_copy(std::make_move_iterator(v.begin()), std::make_move_iterator(v.end()), m_data);
+            m_size = v.m_size;
+            v.clear();
+        } else {
+            m_data = v.m_data;
+            m_size = v.m_size;
+            m_capacity = v.m_capacity;
+            v.m_data = v.inlineData();
+            v.m_size = 0;
+            v.m_capacity = N;
+        }
+    }
+
+    T *m_data;
+    uint32_t m_size;
+    uint32_t m_capacity;
+    typename std::aligned_storage<sizeof(T) * N, alignof(T)>::type m_inline;
+};
+
+#endif //VCARD_SMALL_VECTOR_H
@@ -0,0 +1,164 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VCARD_STRING_REF_H
+#define VCARD_STRING_REF_H
+
+#include <cstring>
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Non-owning view of a character range (the library is C++14, so no std::string_view).
+ * The referenced memory must outlive the view.
+ */
+class vCardStringRef {
+public:
+    static const size_t npos = static_cast<size_t>(-1);
+
+    vCardStringRef(): m_data(""), m_size(0) {}
+    vCardStringRef(const char *data, size_t size): m_data(data), m_size(size) {}
+    vCardStringRef(const char *s): m_data(s), m_size(std::strlen(s)) {}
+    vCardStringRef(const std::string& s): m_data(s.data()), m_size(s.size()) {}
+
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    const char* begin() const { return m_data; }
+    const char* end() const { return m_data + m_size; }
+
+    char operator[] (size_t i) const { return m_data[i]; }
+
+    std::string str() const { return std::string(m_data, m_size); }
+
+    vCardStringRef substr(size_t pos, size_t n = npos) const
+    {
+        if(pos > m_size)
+            pos = m_size;
+        return vCardStringRef(m_data + pos, std::min(n, m_size - pos));
+    }
+
+    size_t find(char c, size_t pos = 0) const
+    {
+        if(pos >= m_size)
+            return npos;
+        const void *p = std::memchr(m_data + pos, c, m_size - pos);
+        return p ? static_cast<const char*>(p) - m_data : npos;
+    }
+
+    size_t find(vCardStringRef s, size_t pos = 0) const
+    {
+        if(pos > m_size)
+            return npos;
+        const char *p = std::search(m_data + pos, end(), s.begin(), s.end());
+        return (p == end() && !s.empty()) ? npos : p - m_data;
+    }
+
+    /**
+     * Case-insensitive (ASCII) comparison, vCard names and parameters are case-insensitive
+     */
+    bool equalsNoCase(vCardStringRef s) const
+    {
+        if(s.m_size != m_size)
+            return false;
+        for(size_t i = 0; i < m_size; i++){
+            char a = m_data[i], b = s.m_data[i];
+            if(a >= 'a' && a <= 'z')
+                a -= 'a' - 'A';
+            if(b >= 'a' && b <= 'z')
+                b -= 'a' - 'A';
+            if(a != b)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * Splits the view by separator, the same rules as split() for strings
+     * @param skip_slashed Do not split on escaped separator ("\;")
+     */
+    std::vector<vCardStringRef> split(char separator, bool skip_slashed = false) const
+    {
+        std::vector<vCardStringRef> result;
+        split(separator, skip_slashed, result);
+        return result;
+    }
+
+    /**
+     * The same as split(), the result is stored in the cleared vector (its memory is reused)
+     */
+    void split(char separator, bool skip_slashed, std::vector<vCardStringRef>& result) const
+    {
+        result.clear();
+        size_t prev_pos = 0, pos = 0;
+        while(pos < m_size)
+        {
+            if(skip_slashed && m_data[pos] == '\\' && pos + 1 < m_size && m_data[pos + 1] == separator)
+            {
+                pos += 2;
+                continue;
+            }
+
+            if(m_data[pos] == separator)
+            {
+                result.push_back(substr(prev_pos, pos - prev_pos));
+                prev_pos = pos + 1;
+            }
+            pos++;
+        }
+
+        result.push_back(substr(prev_pos));
+    }
+
+    /**
+     * Returns the view without leading and trailing whitespaces
+     */
+    vCardStringRef trimmed() const
+    {
+        size_t b = 0, e = m_size;
+        while(b < e && (m_data[b] == ' ' || m_data[b] == '\t'))
+            b++;
+        while(e > b && (m_data[e - 1] == ' ' || m_data[e - 1] == '\t'))
+            e--;
+        return vCardStringRef(m_data + b, e - b);
+    }
+
+protected:
+    const char *m_data;
+    size_t m_size;
+};
+
+inline bool operator == (vCardStringRef a, vCardStringRef b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+inline bool operator != (vCardStringRef a, vCardStringRef b)
+{
+    return !(a == b);
+}
+
+inline std::ostream& operator << (std::ostream& os, vCardStringRef s)
+{
+    return os.write(s.data(), s.size());
+}
+
+#endif //VCARD_STRING_REF_H
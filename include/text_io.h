@@ -21,43 +21,689 @@
 
 #include <iosfwd>
 #include <istream>
+#include <iterator>
+#include <memory>
 #include "vcard.h"
+#include "mapped_file.h"
+#include "output_sink.h"
+#include "string_ref.h"
 
 enum vCardEncoding {
     UTF_8 = 0,
     UTF_16
 };
 
+/**
+ * @brief Parameter of the property line as views into the source buffer
+ */
+class vCardParamRef {
+public:
+    vCardParamRef() {}
+    vCardParamRef(vCardStringRef name, vCardStringRef value): m_name(name), m_value(value) {}
+
+    vCardStringRef getName() const { return m_name; }
+    vCardStringRef getValue() const { return m_value; }
+
+protected:
+    vCardStringRef m_name;
+    vCardStringRef m_value;
+};
+
+/**
+ * @brief Parsed property line which does not own its data: group, name, params and value
+ * are views into the parsed line. Owning vCardProperty is created only by toProperty().
+ */
+class vCardPropertyRef {
+public:
+    vCardPropertyRef(): m_blob(false) {}
+
+    vCardStringRef getGroup() const { return m_group; }
+    vCardStringRef getName() const { return m_name; }
+
+    /**
+     * Returns raw (not split) value of the property
+     */
+    vCardStringRef getValue() const { return m_value; }
+
+    /**
+     * Returns value components split by unescaped ';'
+     */
+    std::vector<vCardStringRef> values() const;
+
+    const std::vector<vCardParamRef>& params() const { return m_params; }
+
+    /**
+     * Binary property (PHOTO, LOGO, SOUND, KEY) with the big inline value,
+     * toProperty() keeps it as the lazy vCardBlob
+     */
+    bool isBlob() const { return m_blob; }
+
+    /**
+     * Returns the whole line in the source buffer (with folds) if the source memory
+     * has the owner (see getOwner()), otherwise empty view
+     */
+    vCardStringRef getSource() const { return m_source; }
+    const std::shared_ptr<const void>& getOwner() const { return m_owner; }
+
+    void clear();
+
+    /**
+     * Creates owning copy of the property
+     */
+    vCardProperty toProperty() const;
+
+    /**
+     * Creates the lazy value of the blob property: a reference into the source if it has
+     * the owner, otherwise a copy of the line
+     */
+    std::shared_ptr<const vCardBlob> makeBlob() const;
+
+    /**
+     * Creates owning property from views. Quoted-printable values and values in legacy
+     * charsets (CHARSET parameter of vCard 2.1) are decoded to UTF-8, ENCODING and CHARSET
+     * parameters are dropped then.
+     */
+    static vCardProperty makeProperty(vCardStringRef group, vCardStringRef name, vCardStringRef value,
+                                      const vCardParamRef *params, size_t params_count);
+
+protected:
+    friend class TextReader;
+    friend class vCardAssembler;
+
+    vCardStringRef m_group;
+    vCardStringRef m_name;
+    vCardStringRef m_value;
+    std::vector<vCardParamRef> m_params;
+
+    bool m_blob;
+    vCardStringRef m_source;
+    std::shared_ptr<const void> m_owner;
+};
+
+/**
+ * @brief Receives cards found by vCardAssembler. Readers use it to build vCard objects
+ * or to store cards in vCardBatch.
+ */
+class vCardBuilder {
+public:
+    virtual ~vCardBuilder() {}
+
+    virtual void beginCard() = 0;
+    virtual void setVersion(vCardVersion version) = 0;
+
+    /**
+     * The property is a view into the current line, it is valid only during the call
+     */
+    virtual void addProperty(const vCardPropertyRef& prop) = 0;
+    virtual void endCard() = 0;
+};
+
+/**
+ * @brief Handler of X- extension properties, see TextReader::setExtensionHandler()
+ */
+class vCardExtensionHandler {
+public:
+    virtual ~vCardExtensionHandler() {}
+
+    /**
+     * Called for every parsed property with the registered name, the property is a view
+     * into the current line
+     * @return true to pass the property to the card (or builder), false to drop it
+     */
+    virtual bool onExtension(const vCardPropertyRef& prop) = 0;
+};
+
+/**
+ * @brief Event callbacks for jobs which only count, route or extract some fields:
+ * no vCard or vCardProperty objects are created. Events come from the same assembler
+ * and tokenizer as parsed cards. Override the needed callbacks only.
+ * Example: TextBufferReader(buffer).parse(handler);
+ */
+class vCardHandler : public vCardBuilder {
+public:
+    virtual void onBeginCard() {}
+    virtual void onVersion(vCardVersion /*version*/) {}
+
+    /**
+     * Views are valid only during the call, values are the raw (not decoded) value
+     * components split by unescaped ';'
+     */
+    virtual void onProperty(vCardStringRef /*group*/, vCardStringRef /*name*/,
+                            const std::vector<vCardParamRef>& /*params*/, const std::vector<vCardStringRef>& /*values*/) {}
+    virtual void onEndCard() {}
+
+    void beginCard() override { onBeginCard(); }
+    void setVersion(vCardVersion version) override { onVersion(version); }
+    void addProperty(const vCardPropertyRef& prop) override;
+    void endCard() override { onEndCard(); }
+
+protected:
+    std::vector<vCardStringRef> m_values;
+};
+
+class vCardBatch;
+
+/**
+ * Reasons of parse diagnostics
+ */
+enum vCardParseError {
+    VC_PARSE_OK = 0,
+    VC_PARSE_NO_COLON,          // property line without ':'
+    VC_PARSE_UNCLOSED_QUOTE,    // parameter value with not closed DQUOTE
+    VC_PARSE_OUTSIDE_CARD,      // not empty line outside of BEGIN:VCARD / END:VCARD
+    VC_PARSE_UNEXPECTED_END     // input ended inside of the card
+};
+
+/**
+ * @brief Problem found in the input, the line is skipped (or the card is dropped) and parsing goes on
+ */
+struct vCardDiagnostic {
+    size_t line;                // 1-based number of the line (the first line of the folded line)
+    size_t offset;              // byte offset of the line in the input (in UTF-8 for converted input)
+    vCardParseError error;
+
+    /**
+     * Returns human readable reason of the error
+     */
+    const char *reason() const;
+};
+
+/**
+ * @brief Receives diagnostics of the readers, see TextReader::setDiagnostics()
+ */
+class vCardDiagnosticSink {
+public:
+    virtual ~vCardDiagnosticSink() {}
+
+    virtual void report(const vCardDiagnostic& diagnostic) = 0;
+};
+
+/**
+ * @brief Sink which collects all diagnostics
+ */
+class vCardDiagnosticList : public vCardDiagnosticSink {
+public:
+    void report(const vCardDiagnostic& diagnostic) override { m_items.push_back(diagnostic); }
+
+    const std::vector<vCardDiagnostic>& items() const { return m_items; }
+    bool empty() const { return m_items.empty(); }
+    void clear() { m_items.clear(); }
+
+protected:
+    std::vector<vCardDiagnostic> m_items;
+};
+
+/**
+ * @brief Collects unfolded lines of the text format into cards.
+ * Shared by all text readers, keeps the state between lines.
+ */
+class vCardAssembler {
+public:
+    vCardAssembler(): m_started(false), m_softBreak(false),
+        m_sink(nullptr), m_line(0), m_offset(0), m_cardLine(0), m_cardOffset(0) {}
+
+    /**
+     * Processes next line of input, found card parts are passed to the builder
+     * @return true when the END of the card is reached and current card is complete
+     */
+    bool feed(vCardStringRef line, vCardBuilder& builder) { return feed(line, vCardStringRef(), builder); }
+
+    /**
+     * @param source The line as it is in the source memory (with folds), binary properties
+     * reference it instead of copying when the owner of the source is set
+     */
+    bool feed(vCardStringRef line, vCardStringRef source, vCardBuilder& builder);
+
+    /**
+     * Sets the owner of the source memory (mapped file or shared buffer)
+     */
+    void setOwner(std::shared_ptr<const void> owner) { m_prop.m_owner = std::move(owner); }
+
+    /**
+     * Malformed lines are reported to the sink, nullptr - skip them silently
+     */
+    void setDiagnostics(vCardDiagnosticSink *sink) { m_sink = sink; }
+    vCardDiagnosticSink *diagnostics() const { return m_sink; }
+
+    /**
+     * Sets position of the next fed line, it is used in diagnostics
+     */
+    void setPosition(size_t line, size_t offset)
+    {
+        m_line = line;
+        m_offset = offset;
+    }
+
+    /**
+     * Ends the input, not completed card is reported and dropped
+     */
+    void finish();
+
+    /**
+     * Only properties with these names (case-insensitive) are parsed, other lines are skipped
+     * after reading the name (they are not validated). Empty list - parse all properties.
+     */
+    void setProjection(std::vector<std::string> names) { m_projection = std::move(names); }
+    const std::vector<std::string>& projection() const { return m_projection; }
+
+    /**
+     * Registers the handler of X- extension property, nullptr removes the handler
+     * @throws std::runtime_error Is thrown if the name does not start with "X-"
+     */
+    void setExtensionHandler(const std::string& name, vCardExtensionHandler *handler);
+
+    typedef std::vector<std::pair<std::string, vCardExtensionHandler*>> ExtensionHandlers;
+    const ExtensionHandlers& extensionHandlers() const { return m_extensions; }
+    void setExtensionHandlers(const ExtensionHandlers& handlers) { m_extensions = handlers; }
+
+protected:
+    void report(vCardParseError error, size_t line, size_t offset);
+
+    /**
+     * Parses the property line and passes it to the builder. Quoted-printable line ending
+     * with the soft line break is kept until the next line
+     */
+    void addProperty(vCardStringRef line, vCardStringRef name, vCardStringRef source, vCardBuilder& builder,
+                     bool soft_break = true);
+
+    bool m_started;
+    bool m_softBreak;
+    std::string m_joined;
+    vCardPropertyRef m_prop;
+
+    vCardDiagnosticSink *m_sink;
+    size_t m_line;
+    size_t m_offset;
+    size_t m_cardLine;          // position of BEGIN line of the current card
+    size_t m_cardOffset;
+
+    std::vector<std::string> m_projection;
+    ExtensionHandlers m_extensions;
+};
+
+/**
+ * @brief Input iterator reading cards one by one. It keeps one vCard object
+ * which is reused for every card, copy (or move) the card if it is needed after increment.
+ */
+template<class Reader>
+class vCardIterator {
+public:
+    typedef std::input_iterator_tag iterator_category;
+    typedef vCard value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef vCard* pointer;
+    typedef vCard& reference;
+
+    vCardIterator(): m_reader(nullptr) {}
+    explicit vCardIterator(Reader *reader): m_reader(reader) { ++*this; }
+
+    vCard& operator * () { return m_card; }
+    vCard* operator -> () { return &m_card; }
+
+    vCardIterator& operator ++ ()
+    {
+        if(m_reader && !m_reader->readCard(m_card))
+            m_reader = nullptr;
+        return *this;
+    }
+
+    bool operator == (const vCardIterator& it) const { return m_reader == it.m_reader; }
+    bool operator != (const vCardIterator& it) const { return m_reader != it.m_reader; }
+
+protected:
+    Reader *m_reader;
+    vCard m_card;
+};
+
 class TextReader {
 public:
-    TextReader(std::istream& is, vCardEncoding code = UTF_8): m_is(&is) {}
+    typedef vCardIterator<TextReader> iterator;
+
+    /**
+     * @param code Encoding of the stream. UTF-16 and UTF-8 BOM are detected anyway,
+     * UTF_16 without BOM means little endian. UTF-16 is converted to UTF-8 while reading.
+     */
+    TextReader(std::istream& is, vCardEncoding code = UTF_8):
+        m_is(&is), m_head(0), m_tail(0), m_eof(false), m_fail(false),
+        m_code(code), m_detected(false), m_utf16(false), m_bigEndian(false),
+        m_consumed(0), m_lineNumber(1) {}
     ~TextReader() {}
 
     static vCardParamMap parseParams(std::string line);
     static vCardProperty parseProperty(std::string line);
+
+    /**
+     * Zero-copy versions of parsers: results are views into the input line,
+     * output containers are cleared and reused to avoid allocations
+     * @throws std::runtime_error Is thrown on malformed input
+     */
+    static void parseParams(vCardStringRef line, std::vector<vCardParamRef>& params);
+    static void parseProperty(vCardStringRef line, vCardPropertyRef& prop);
+
+    /**
+     * Non-throwing versions of the zero-copy parsers
+     * @return VC_PARSE_OK or the reason of the error
+     */
+    static vCardParseError tryParseParams(vCardStringRef line, std::vector<vCardParamRef>& params);
+    static vCardParseError tryParseProperty(vCardStringRef line, vCardPropertyRef& prop);
+
+    /**
+     * Malformed lines are skipped, they are reported to the sink if it is set.
+     * The sink must outlive the reader.
+     */
+    void setDiagnostics(vCardDiagnosticSink *sink) { m_assembler.setDiagnostics(sink); }
+
+    /**
+     * Parses only properties with given names, e.g. {VC_FORMATTED_NAME, VC_EMAIL, VC_TELEPHONE}.
+     * Other lines are skipped after reading their names: no params and values are parsed.
+     */
+    void setProjection(std::vector<std::string> names) { m_assembler.setProjection(std::move(names)); }
+
+    /**
+     * Registers the handler of X- extension property (e.g. "X-SKYPE"), it is called for every
+     * such property and decides if it is kept. The handler must outlive the reader, with
+     * parseCards(threads) it is called from the worker threads.
+     * @throws std::runtime_error Is thrown if the name does not start with "X-"
+     */
+    void setExtensionHandler(const std::string& name, vCardExtensionHandler *handler)
+    {
+        m_assembler.setExtensionHandler(name, handler);
+    }
+
     std::vector<vCard> parseCards();
 
+    /**
+     * Reads the rest of the stream into memory and parses it in parallel,
+     * see TextBufferReader::parseCards(unsigned)
+     */
+    std::vector<vCard> parseCards(unsigned threads);
+
+    /**
+     * Reads next unfolded line. The view is valid until the next call
+     * @return false if the end of stream is reached
+     */
+    bool readLine(vCardStringRef& line);
+
+    /**
+     * Reads next card from the stream. Only one card is kept in memory,
+     * the card object and the line buffer are reused between calls
+     * @return false if there are no more cards
+     */
+    bool readCard(vCard& card);
+
+    /**
+     * Reads cards into the batch, all cards of the batch share one memory arena
+     * @param max_cards The maximum number of cards to read, 0 - read all cards
+     * @return The number of cards read
+     */
+    size_t readBatch(vCardBatch& batch, size_t max_cards = 0);
+
+    /**
+     * Reads the rest of the stream passing cards to the builder or vCardHandler
+     * @return The number of cards
+     */
+    size_t parse(vCardBuilder& builder);
+
+    /**
+     * Example: while(reader >> card) { ... }
+     */
     TextReader & operator >> (vCard & vCard);
+
+    /**
+     * Appends all remaining cards to the vector
+     */
     TextReader & operator >> (std::vector<vCard> & cards);
     //TextReader & operator >> (vCardProperty & prop);
     //TextReader & operator >> (vCardParamMap & param);
 
+    /**
+     * Returns false if the last read operation found no card
+     */
+    explicit operator bool() const { return !m_fail; }
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
 protected:
     std::istream *m_is;
+    std::string m_buffer;
+    size_t m_head;
+    size_t m_tail;
+    bool m_eof;
+    std::string m_unfolded;
+    vCardAssembler m_assembler;
+    bool m_fail;
+
+    vCardEncoding m_code;
+    bool m_detected;
+    bool m_utf16;
+    bool m_bigEndian;
+    std::string m_raw;          // not converted UTF-16 input
+
+    size_t m_consumed;          // bytes removed from the beginning of m_buffer
+    size_t m_lineNumber;        // number of the next line
+
+    void fillBuffer();
+
+    /**
+     * Reads the next block of the stream converted to UTF-8
+     * @return The number of bytes written to dst, 0 at the end of the stream
+     */
+    size_t readInput(char *dst, size_t capacity);
+};
+
+/**
+ * @brief Reader over contiguous memory buffer. Lines are returned as views into the buffer
+ * (only folded lines are unfolded into internal buffer), so parsing does not copy the input.
+ * The buffer must outlive the reader and all views returned by it.
+ * UTF-16 input (BOM or `code`, see TextReader) is converted to UTF-8 once, then the reader
+ * works on the converted copy.
+ */
+class TextBufferReader {
+public:
+    typedef vCardIterator<TextBufferReader> iterator;
+
+    TextBufferReader(const char *data, size_t size, vCardEncoding code = UTF_8);
+    TextBufferReader(const std::string& buffer, vCardEncoding code = UTF_8);
+
+    /**
+     * Reads memory mapped file. Already parsed pages are periodically released,
+     * so the resident memory does not grow with the file size.
+     * Example: TextBufferReader reader(std::make_shared<vCardMappedFile>("contacts.vcf"));
+     */
+    TextBufferReader(std::shared_ptr<const vCardMappedFile> file, vCardEncoding code = UTF_8);
+
+    /**
+     * Reads shared buffer. Binary properties of the parsed cards reference the buffer
+     * instead of copying, the buffer is kept alive while they exist
+     */
+    TextBufferReader(std::shared_ptr<const std::string> buffer, vCardEncoding code = UTF_8);
+    ~TextBufferReader() {}
+
+    /**
+     * Reads next unfolded line. The view is valid until the next call
+     * @return false if the end of buffer is reached
+     */
+    bool readLine(vCardStringRef& line);
+
+    std::vector<vCard> parseCards();
+
+    /**
+     * Splits the rest of the buffer into chunks at card boundaries and parses them
+     * by the pool of threads. Cards are returned in the original order.
+     * @param threads The number of threads, 0 - use all hardware threads
+     */
+    std::vector<vCard> parseCards(unsigned threads);
+
+    /**
+     * Reads next card from the buffer
+     * @return false if there are no more cards
+     */
+    bool readCard(vCard& card);
+
+    /**
+     * Reads cards into the batch, see TextReader::readBatch
+     */
+    size_t readBatch(vCardBatch& batch, size_t max_cards = 0);
+
+    /**
+     * See TextReader::parse
+     */
+    size_t parse(vCardBuilder& builder);
+
+    /**
+     * See TextReader::setDiagnostics
+     */
+    void setDiagnostics(vCardDiagnosticSink *sink) { m_assembler.setDiagnostics(sink); }
+
+    /**
+     * See TextReader::setProjection
+     */
+    void setProjection(std::vector<std::string> names) { m_assembler.setProjection(std::move(names)); }
+
+    /**
+     * See TextReader::setExtensionHandler
+     */
+    void setExtensionHandler(const std::string& name, vCardExtensionHandler *handler)
+    {
+        m_assembler.setExtensionHandler(name, handler);
+    }
+
+    bool eof() const { return m_pos == m_end; }
+
+    iterator begin() { return iterator(this); }
+    iterator end() { return iterator(); }
+
+protected:
+    friend class TextReader;
+
+    const char *m_begin;
+    const char *m_end;
+    const char *m_pos;
+    const char *m_line;         // beginning of the last read line in the buffer
+    size_t m_lineNumber;        // number of the next line
+    size_t m_baseOffset;        // offset of m_begin in the whole input
+    std::string m_unfolded;
+    vCardAssembler m_assembler;
+    std::shared_ptr<const void> m_owner;
+
+    vCardStringRef lineSource() const { return vCardStringRef(m_line, m_pos - m_line); }
+
+    std::shared_ptr<const vCardMappedFile> m_file;
+    size_t m_released;
+};
+
+/**
+ * @brief Push parser: the input is fed by chunks of any size (e.g. from the socket),
+ * chunks may end anywhere, also inside of the line, fold or CRLF. Only the incomplete
+ * last line is buffered between calls.
+ */
+class TextPushParser {
+public:
+    TextPushParser();
+
+    /**
+     * Parses the next chunk of input, completed cards are appended to `cards`
+     * @return The number of completed cards
+     */
+    size_t feed(const char *data, size_t size, std::vector<vCard>& cards);
+
+    /**
+     * Parses the next chunk, card parts are passed to the builder (e.g. vCardBatch).
+     * The same builder must receive all chunks, a card may span several of them.
+     */
+    size_t feed(const char *data, size_t size, vCardBuilder& builder);
+
+    /**
+     * Ends the input: the last line may be without line end, not completed card is dropped.
+     * The parser can be fed with the new input after that.
+     */
+    size_t finish(std::vector<vCard>& cards);
+    size_t finish(vCardBuilder& builder);
+
+    /**
+     * See TextReader::setDiagnostics
+     */
+    void setDiagnostics(vCardDiagnosticSink *sink) { m_assembler.setDiagnostics(sink); }
+
+    /**
+     * See TextReader::setProjection
+     */
+    void setProjection(std::vector<std::string> names) { m_assembler.setProjection(std::move(names)); }
+
+    /**
+     * See TextReader::setExtensionHandler
+     */
+    void setExtensionHandler(const std::string& name, vCardExtensionHandler *handler)
+    {
+        m_assembler.setExtensionHandler(name, handler);
+    }
+
+    /**
+     * Returns the number of buffered bytes of the incomplete line
+     */
+    size_t buffered() const { return m_buffer.size(); }
+
+protected:
+    size_t parse(const char *data, size_t size, bool eof, vCardBuilder& builder, std::vector<vCard> *cards);
+
+    std::string m_buffer;       // the incomplete line and the new chunk
+    size_t m_scan;              // the line end search is resumed from here
+    std::string m_unfolded;
+    vCardAssembler m_assembler;
+    vCard m_card;
+    size_t m_consumed;          // bytes removed from the beginning of m_buffer
+    size_t m_lineNumber;
+    bool m_bomChecked;
+    bool m_skipLf;              // the previous chunk ended with CR of the completed END line
 };
 
 class TextWriter {
 public:
-    TextWriter(std::ostream& os, vCardEncoding code = UTF_8): m_os(&os) {}
-    ~TextWriter() {}
+    /**
+     * @param code UTF_16 writes UTF-16LE with BOM, the output is flushed after every card
+     */
+    TextWriter(std::ostream& os, vCardEncoding code = UTF_8);
+
+    /**
+     * Writes UTF-8 to the sink, the sink gets the output by blocks, so flush() it after writing
+     */
+    explicit TextWriter(vCardOutputSink& sink);
+    ~TextWriter();
 
     TextWriter & operator << (vCard & vCard);
     TextWriter & operator << (std::vector<vCard> & cards);
     TextWriter & operator << (vCardProperty & prop);
     TextWriter & operator << (vCardParamMap & param);
 
+    /**
+     * Writes the cards formatted on `threads` threads (0 - number of cores), the output is the
+     * same as of operator << (std::vector<vCard>&)
+     */
+    TextWriter & write(std::vector<vCard> & cards, unsigned threads);
+
 protected:
-    std::ostream *m_os;
+    void writeCards(std::vector<vCard>& cards, size_t begin, size_t end);
+    void writeCard(vCard& card);
+    void writeProperty(vCardProperty& prop);
+    void writeParams(vCardParamMap& params);
+
+    /**
+     * Folds the line starting at `start` of the buffer to 75 octets (RFC 6350 3.2),
+     * UTF-8 sequences are not split
+     */
+    void foldLine(size_t start);
+
+    /**
+     * Flushes the stream sink, other sinks are flushed only when their block is filled
+     */
+    void finishOutput();
+
+    vCardOutputSink *m_sink;
+    std::unique_ptr<std::streambuf> m_utf16;
+    std::unique_ptr<std::ostream> m_stream;
+    std::unique_ptr<vCardOutputSink> m_ownSink;     // sink of the stream
+    std::string m_line;         // the line being folded
 };
 
 #endif //VCARD_TEXT_IO_H
@@ -19,9 +19,15 @@
 #ifndef CONTACTS_COMMANDER_VCARD_H
 #define CONTACTS_COMMANDER_VCARD_H
 
+#include <ostream>
 #include <string>
 #include <vector>
 #include <map>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include "string_ref.h"
+#include "small_vector.h"
 
 #define VC_SEPARATOR_TOKEN ';'
 #define VC_END_LINE_TOKEN "\r\n"
@@ -65,14 +71,76 @@ enum vCardVersion
 #define VC_URL                  "URL"
 #define VC_VERSION              "VERSION"
 
-typedef std::multimap<std::string, std::string>::iterator param_iterator;
+/**
+ * @brief Property or parameter name. Known names (VC_* properties, RFC 6350 and RFC 2426
+ * properties and parameters, common X- extensions) are pointers into the static table and are
+ * compared as integers. Other names are stored in the object itself, so reading unknown
+ * X- names does not touch any shared state and nothing is kept after the object is gone.
+ */
+class vCardName {
+public:
+    vCardName();
+    explicit vCardName(vCardStringRef name);
+    vCardName(const std::string& name): vCardName(vCardStringRef(name)) {}
+    vCardName(const char *name): vCardName(vCardStringRef(name)) {}
+
+    const std::string& str() const { return m_name ? *m_name : m_custom; }
+    operator const std::string& () const { return str(); }
+
+    /**
+     * Returns true if the name is from the static table of known names
+     */
+    bool isKnown() const { return m_name != nullptr; }
+
+    /**
+     * Equal names have equal hashes
+     */
+    size_t hash() const
+    {
+        return m_name ? static_cast<size_t>((reinterpret_cast<uintptr_t>(m_name) >> 3) * 0x9E3779B97F4A7C15ULL)
+                      : customHash();
+    }
+
+    // A known name is never stored as a custom one, so different pointers mean different names
+    bool operator == (const vCardName& n) const { return m_name == n.m_name && (m_name || m_custom == n.m_custom); }
+    bool operator != (const vCardName& n) const { return !(*this == n); }
+
+    /**
+     * Alphabetical order
+     */
+    bool operator < (const vCardName& n) const { return (m_name != n.m_name || !m_name) && str() < n.str(); }
+
+protected:
+    size_t customHash() const;
+
+    const std::string *m_name;     // nullptr for names which are not in the static table
+    std::string m_custom;
+};
+
+inline bool operator == (const vCardName& a, const std::string& b) { return a.str() == b; }
+inline bool operator == (const std::string& a, const vCardName& b) { return a == b.str(); }
+inline bool operator == (const vCardName& a, const char *b) { return a.str() == b; }
+inline bool operator != (const vCardName& a, const std::string& b) { return a.str() != b; }
+inline bool operator != (const vCardName& a, const char *b) { return a.str() != b; }
+
+inline std::ostream& operator << (std::ostream& os, const vCardName& name)
+{
+    return os << name.str();
+}
+
+typedef std::pair<vCardName, std::string> vCardParam;
+typedef vCardParam* param_iterator;
+typedef const vCardParam* const_param_iterator;
 
 /**
  * @brief Property parameters holder. We can have multiple parameters with the same name
- * Based on std::multimap
+ * Flat array sorted by name (parameters with the same name keep the insertion order, as in std::multimap),
+ * the first VC_INLINE_PARAMS parameters are stored without heap allocations.
  */
 class vCardParamMap {
 public:
+    static const size_t VC_INLINE_PARAMS = 3;
+
     vCardParamMap() {}
     ~vCardParamMap() {}
 
@@ -89,14 +157,16 @@ public:
      * @param name The name of the parameter
      * @return The count of parameters
      */
-    int count(std::string name) const { return m_params.count(name); }
+    int count(vCardStringRef name) const;
 
     param_iterator begin() {return m_params.begin(); }
     param_iterator end() {return m_params.end(); }
+    const_param_iterator begin() const {return m_params.begin(); }
+    const_param_iterator end() const {return m_params.end(); }
 
-    void addParam(std::string name, std::string value);
-    void setParam(std::string name, std::string value);
-    void removeParam(std::string name);
+    void addParam(vCardStringRef name, std::string value);
+    void setParam(vCardStringRef name, std::string value);
+    void removeParam(vCardStringRef name);
 
     /**
      * We can have multiple parameters with the same name, so return
@@ -104,7 +174,7 @@ public:
      * @param name The name of the parameter
      * @return std::pair of begin and end iterators
      */
-    std::pair<param_iterator, param_iterator> getParams(std::string name);
+    std::pair<param_iterator, param_iterator> getParams(vCardStringRef name);
 
     /**
      * We can have multiple parameters with the same name, so [] operator returns
@@ -113,10 +183,77 @@ public:
      * @return string value of the parameter
      * @throws std::runtime_error Is thrown if parameter not found
      */
-    std::string& operator[] (std::string name);
+    std::string& operator[] (vCardStringRef name);
 
 protected:
-    std::multimap<std::string, std::string> m_params;
+    std::pair<param_iterator, param_iterator> range(vCardStringRef name);
+
+    vCardSmallVector<vCardParam, VC_INLINE_PARAMS> m_params;
+};
+
+class vCardBlob;
+class vCardTypedValue;
+
+/**
+ * @brief Structured value of ADR property, the fields are unescaped
+ */
+struct vCardAddress {
+    std::string postOfficeBox;
+    std::string extendedAddress;
+    std::string street;
+    std::string locality;
+    std::string region;
+    std::string postalCode;
+    std::string country;
+};
+
+/**
+ * @brief Structured value of N property, the fields are unescaped
+ */
+struct vCardPersonName {
+    std::string lastname;
+    std::string firstname;
+    std::string additional;
+    std::string prefix;
+    std::string suffix;
+};
+
+/**
+ * @brief GEO property value ("geo:37.386,-122.082" of vCard 4.0 or "37.386;-122.082")
+ */
+struct vCardGeoPosition {
+    double latitude = 0;
+    double longitude = 0;
+};
+
+/**
+ * @brief Date and/or time value of BDAY, ANNIVERSARY, REV properties, basic ("19960415T133000Z")
+ * and extended ("1996-04-15T13:30:00-05:00") formats. Omitted fields are zero, e.g. year of "--0415".
+ */
+struct vCardDateTime {
+    bool hasDate = false;
+    bool hasTime = false;
+    bool hasZone = false;
+    int year = 0;
+    int month = 0;
+    int day = 0;
+    int hour = 0;
+    int minute = 0;
+    int second = 0;
+    int zone = 0;       // UTC offset in minutes
+
+    /**
+     * Seconds since 1970-01-01 UTC, the time without zone is taken as UTC
+     */
+    int64_t toUnixTime() const;
+};
+
+/**
+ * @brief TEL property value, plain text ("+1 (555) 010-0100") or "tel:" URI
+ */
+struct vCardTelephone {
+    std::string number;     // digits, leading '+', '*' and '#', separators are removed
+    std::string extension;  // ";ext=" parameter of the URI
 };
 
 /**
@@ -145,30 +282,71 @@ public:
     /// Used as indexes for GEO property values
     enum GeoPositionFields { Latitude = 0, Longitude };
 
-    vCardProperty() {}
-    vCardProperty(const std::string& group, const std::string& name, const std::string& value);
-    vCardProperty(const std::string& name, const std::string& value);
-    vCardProperty(const std::string& name, const std::vector<std::string>& values): m_name(name), m_values(values) {}
+    vCardProperty(): m_split(false) {}
+    vCardProperty(std::string group, const std::string& name, std::string value);
+    vCardProperty(const std::string& name, std::string value);
+    vCardProperty(const std::string& name, const std::vector<std::string>& values): m_name(name), m_values(values), m_split(true) {}
     vCardProperty(const std::string& name, const std::vector<std::string>& values, const vCardParamMap params):
-                    m_name(name), m_values(values), m_params(params) {}
+                    m_name(name), m_values(values), m_split(true), m_params(params) {}
     ~vCardProperty() {}
 
-    std::string& getName() { return m_name; }
+    const std::string& getName() const { return m_name.str(); }
+    const vCardName& getNameAtom() const { return m_name; }
     std::string& getGroup() { return m_group; }
 
     /**
-     * Returns joined values list in one string
+     * Returns the whole value. The raw value is returned as is, the values list is
+     * joined only if it was requested (and possibly changed) through values()
+     */
+    const std::string& getValue();
+
+    /**
+     * Returns the size of getValue() without joining the values list, not materialized blobs
+     * have size 0. Used to estimate the output size.
+     */
+    size_t valueSize() const;
+
+    /**
+     * Replaces the value, the values list is split again on the next values() call
+     */
+    void setValue(std::string value);
+
+    /**
+     * Binary properties (PHOTO, LOGO, SOUND, KEY) read from text are kept as lazy references
+     * into the source. The value is unfolded on the first getValue() or values() call,
+     * getBinary() decodes it without keeping the text in the property.
+     */
+    bool isBlob() const { return m_blob != nullptr; }
+    const std::shared_ptr<const vCardBlob>& getBlob() const { return m_blob; }
+    void setBlob(std::shared_ptr<const vCardBlob> blob);
+
+    /**
+     * Returns decoded binary value: base64 (ENCODING parameter or "data:" URI) is decoded,
+     * other values are returned as is
+     * @throws std::runtime_error Is thrown on malformed base64 data
      */
-    std::string getValue();
+    std::string getBinary();
 
     /**
-     * Returns list of string values
+     * Returns list of string values, the raw value is split on the first call
      */
-    std::vector<std::string>& values() {return m_values; }
+    std::vector<std::string>& values();
 
     void setParams(vCardParamMap params);
     vCardParamMap& params() { return m_params; }
 
+    /**
+     * Typed views of structured values. The value is parsed on the first call and cached
+     * in the property, the returned reference is valid until the value is changed
+     * (setValue(), setBlob() or values() call).
+     * @throws std::runtime_error Is thrown if the value is malformed (GEO, dates)
+     */
+    const vCardAddress& address();
+    const vCardPersonName& personName();
+    const vCardGeoPosition& geoPosition();
+    const vCardDateTime& dateTime();
+    const vCardTelephone& telephone();
+
     /**
      * Shortcut for adding parameters to property
      * Example: prop << parameters;
@@ -185,13 +363,79 @@ public:
     static vCardProperty createName(const std::string& firstname, const std::string& lastname,
             const std::string& additional = "", const std::string& prefix = "",
             const std::string& suffix = "", const vCardParamMap& params = vCardParamMap());
+    /**
+     * Creates binary property (PHOTO, LOGO, SOUND, KEY) with inline data and ENCODING=b parameter,
+     * the data is base64 encoded only when the property is written
+     */
+    static vCardProperty createBinary(const std::string& name, std::string data, const std::string& type = "");
     static vCardProperty createOrganization(const std::string& name, const std::vector<std::string>& levels = std::vector<std::string>(), const vCardParamMap& params = vCardParamMap());
 
 protected:
     std::string m_group;
-    std::string m_name;
-    std::vector<std::string> m_values;
+    vCardName m_name;
+    std::string m_value;                    // raw value, stale while m_split is set
+    std::vector<std::string> m_values;      // split value, valid while m_split is set
+    bool m_split;
     vCardParamMap m_params;
+    std::shared_ptr<const vCardBlob> m_blob;   // not materialized value of binary property
+    std::shared_ptr<const vCardTypedValue> m_typed;    // cached typed view, reset on value changes
+};
+
+/**
+ * @brief Properties of the card with the same name, in the order of addition.
+ * Follows the positions chain of the card index, so iteration does not scan the whole card.
+ * Points into the storage of the card: like iterators of std::vector it is invalidated by any
+ * change of the card (addProperty, removeProperty, clear, changes through properties()) and
+ * when the card is copied, moved or destroyed.
+ */
+class vCardPropertySet {
+public:
+    class iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef vCardProperty value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef vCardProperty* pointer;
+        typedef vCardProperty& reference;
+
+        iterator(): m_properties(nullptr), m_next(nullptr), m_pos(0) {}
+        iterator(vCardProperty *properties, const uint32_t *next, uint32_t pos):
+                m_properties(properties), m_next(next), m_pos(pos) {}
+
+        vCardProperty& operator * () const { return m_properties[m_pos]; }
+        vCardProperty* operator -> () const { return m_properties + m_pos; }
+
+        iterator& operator ++ () { m_pos = m_next[m_pos]; return *this; }
+        iterator operator ++ (int) { iterator it = *this; ++*this; return it; }
+
+        bool operator == (const iterator& it) const { return m_pos == it.m_pos; }
+        bool operator != (const iterator& it) const { return m_pos != it.m_pos; }
+
+    protected:
+        vCardProperty *m_properties;
+        const uint32_t *m_next;
+        uint32_t m_pos;
+    };
+
+    static const uint32_t npos = static_cast<uint32_t>(-1);
+
+    vCardPropertySet(): m_properties(nullptr), m_next(nullptr), m_first(npos), m_size(0) {}
+    vCardPropertySet(vCardProperty *properties, const uint32_t *next, uint32_t first, size_t size):
+            m_properties(properties), m_next(next), m_first(first), m_size(size) {}
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    iterator begin() const { return iterator(m_properties, m_next, m_first); }
+    iterator end() const { return iterator(m_properties, m_next, npos); }
+
+    vCardProperty& front() const { return m_properties[m_first]; }
+
+protected:
+    vCardProperty *m_properties;
+    const uint32_t *m_next;
+    uint32_t m_first;
+    size_t m_size;
 };
 
 /**
@@ -199,7 +443,7 @@ protected:
  */
 class vCard {
 public:
-    vCard(vCardVersion v = VC_VER_4_0): m_version(v)  {}
+    vCard(vCardVersion v = VC_VER_4_0): m_version(v), m_indexedNames(0), m_indexed(false)  {}
     ~vCard() {}
 
     /**
@@ -207,14 +451,27 @@ public:
      */
     int count() const { return m_properties.size(); };
 
+    /**
+     * Removes all properties and resets the version, keeps allocated memory for reuse
+     */
+    void clear() { m_properties.clear(); m_version = VC_VER_4_0; m_indexed = false; }
+
     void addProperty(const vCardProperty& property);
+    void addProperty(vCardProperty&& property);
 
     /**
      * Removes all found properties with the specified name
      */
-    void removeProperty(std::string name);
+    void removeProperty(vCardStringRef name);
 
-    std::vector<vCardProperty>& properties() { return m_properties; }
+    /**
+     * Direct access to the properties, drops the name index (it is rebuilt on the next lookup).
+     * The reference may be kept: lookups check the index against the number of properties and
+     * the names of the found ones. After replacing a property in place by one with another name,
+     * call properties() again so the new name is found.
+     */
+    std::vector<vCardProperty>& properties() { m_indexed = false; return m_properties; }
+    const std::vector<vCardProperty>& properties() const { return m_properties; }
 
     vCardVersion getVersion() { return m_version; }
     std::string getVersionStr();
@@ -222,8 +479,14 @@ public:
 
     /**
      * Returns first found property with the specified name
+     * @throws std::runtime_error Is thrown if property not found
      */
-    vCardProperty& operator[] (std::string name);
+    vCardProperty& operator[] (vCardStringRef name);
+
+    /**
+     * Returns all properties with the specified name (all TEL or EMAIL), in the order of addition
+     */
+    vCardPropertySet getProperties(vCardStringRef name);
 
     /**
      * Shortcut for adding property to the vCard
@@ -231,8 +494,35 @@ public:
     vCard & operator << (const vCardProperty &p);
 
 protected:
+    /**
+     * Name index slot: first and last positions of the properties with the name,
+     * other positions are chained through m_next
+     */
+    struct IndexSlot {
+        vCardName name;
+        uint32_t first;
+        uint32_t last;
+        uint32_t count;
+    };
+
+    /**
+     * Returns the slot of the name, the index is (re)built if it is missing or does not match
+     * the properties (changed through a kept properties() reference)
+     */
+    const IndexSlot* findSlot(const vCardName& name);
+    const IndexSlot* lookupSlot(const vCardName& name) const;
+    bool isSlotValid(const IndexSlot& slot) const;
+    void buildIndex();
+    void indexProperty(uint32_t pos);
+
     std::vector<vCardProperty> m_properties;
     vCardVersion m_version;
+
+    // Name index, built on the first lookup by name and updated by addProperty
+    std::vector<IndexSlot> m_slots;
+    std::vector<uint32_t> m_next;
+    uint32_t m_indexedNames;
+    bool m_indexed;
 };
 
 
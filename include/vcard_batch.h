@@ -0,0 +1,205 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VCARD_BATCH_H
+#define VCARD_BATCH_H
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "vcard.h"
+#include "text_io.h"
+
+/**
+ * @brief Monotonic memory arena. Memory is taken from big blocks by moving a pointer
+ * and is released only all at once, so there are no per-object malloc/free calls.
+ */
+class vCardArena {
+public:
+    explicit vCardArena(size_t block_size = 64 * 1024);
+    ~vCardArena() { release(); }
+
+    vCardArena(const vCardArena&) = delete;
+    vCardArena& operator = (const vCardArena&) = delete;
+    vCardArena(vCardArena&& arena);
+    vCardArena& operator = (vCardArena&& arena);
+
+    void *allocate(size_t size, size_t align);
+
+    template<class T>
+    T *allocate(size_t count) { return static_cast<T*>(allocate(sizeof(T) * count, alignof(T))); }
+
+    /**
+     * Copies the string into the arena
+     */
+    vCardStringRef copy(vCardStringRef s);
+
+    /**
+     * Releases all memory, the cost depends only on the number of blocks
+     */
+    void release();
+
+    /**
+     * Returns total size of blocks taken from the system
+     */
+    size_t capacity() const { return m_capacity; }
+
+protected:
+    struct Block {
+        Block *next;
+    };
+
+    Block *m_blocks;
+    char *m_pos;
+    char *m_end;
+    size_t m_blockSize;
+    size_t m_capacity;
+};
+
+/**
+ * @brief Read-only range of objects stored in the arena
+ */
+template<class T>
+class vCardRange {
+public:
+    vCardRange(): m_begin(nullptr), m_end(nullptr) {}
+    vCardRange(const T *begin, const T *end): m_begin(begin), m_end(end) {}
+
+    const T* begin() const { return m_begin; }
+    const T* end() const { return m_end; }
+    size_t size() const { return m_end - m_begin; }
+    bool empty() const { return m_begin == m_end; }
+
+    const T& operator[] (size_t i) const { return m_begin[i]; }
+
+protected:
+    const T *m_begin;
+    const T *m_end;
+};
+
+/**
+ * @brief Cards parsed by one readBatch() call. All strings and properties of all cards
+ * are stored in one arena, so the batch is built without small allocations
+ * and is dropped at once. Cards can be converted to vCard objects on demand.
+ * Big binary values are copied into the arena only when the source is transient
+ * (stream readers, push parser, buffers without the owner), see Property::isBlob().
+ *
+ * Example:
+ *   vCardBatch batch;
+ *   reader.readBatch(batch);
+ *   for(const vCardBatch::Card& card : batch) { const vCardBatch::Property *fn = card.find("FN"); ... }
+ */
+class vCardBatch : public vCardBuilder {
+public:
+    class Property {
+    public:
+        vCardStringRef getGroup() const { return m_group; }
+        vCardStringRef getName() const { return m_name; }
+
+        /**
+         * Returns the value, empty for blob properties (see getBlob())
+         */
+        vCardStringRef getValue() const { return m_value; }
+
+        /**
+         * Binary properties (PHOTO, LOGO, SOUND, KEY) with big values read from the source with
+         * the owner (TextBufferReader over the mapped file or the shared buffer) are not copied
+         * into the arena, they are kept as lazy references into the source
+         */
+        bool isBlob() const { return m_blob != nullptr; }
+        const vCardBlob *getBlob() const { return m_blob ? m_blob->get() : nullptr; }
+
+        /**
+         * Returns value components split by unescaped ';'
+         */
+        std::vector<vCardStringRef> values() const { return m_value.split(VC_SEPARATOR_TOKEN, true); }
+
+        vCardRange<vCardParamRef> params() const { return vCardRange<vCardParamRef>(m_params, m_params + m_paramsCount); }
+
+        vCardProperty toProperty() const;
+
+    protected:
+        friend class vCardBatch;
+
+        vCardStringRef m_group;
+        vCardStringRef m_name;
+        vCardStringRef m_value;
+        const vCardParamRef *m_params;
+        size_t m_paramsCount;
+        const std::shared_ptr<const vCardBlob> *m_blob;    // element of vCardBatch::m_blobs
+    };
+
+    class Card {
+    public:
+        vCardVersion getVersion() const { return m_version; }
+        int count() const { return m_properties.size(); }
+
+        vCardRange<Property> properties() const { return m_properties; }
+
+        /**
+         * Returns first found property with the specified name or nullptr
+         */
+        const Property* find(vCardStringRef name) const;
+
+        vCard toCard() const;
+
+    protected:
+        friend class vCardBatch;
+
+        vCardVersion m_version;
+        vCardRange<Property> m_properties;
+    };
+
+    typedef std::vector<Card>::const_iterator iterator;
+
+    vCardBatch(): m_version(VC_VER_4_0) {}
+    ~vCardBatch() {}
+
+    size_t size() const { return m_cards.size(); }
+    bool empty() const { return m_cards.empty(); }
+
+    const Card& operator[] (size_t i) const { return m_cards[i]; }
+
+    iterator begin() const { return m_cards.begin(); }
+    iterator end() const { return m_cards.end(); }
+
+    std::vector<vCard> toCards() const;
+
+    /**
+     * Removes all cards and releases the memory
+     */
+    void clear();
+
+    const vCardArena& arena() const { return m_arena; }
+
+    // vCardBuilder interface, used by readers
+    void beginCard() override;
+    void setVersion(vCardVersion version) override { m_version = version; }
+    void addProperty(const vCardPropertyRef& prop) override;
+    void endCard() override;
+
+protected:
+    vCardArena m_arena;
+    std::deque<std::shared_ptr<const vCardBlob>> m_blobs;     // properties keep pointers to the elements
+    std::vector<Card> m_cards;
+    std::vector<Property> m_current;
+    vCardVersion m_version;
+};
+
+#endif //VCARD_BATCH_H
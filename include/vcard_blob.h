@@ -0,0 +1,101 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef VCARD_BLOB_H
+#define VCARD_BLOB_H
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include "string_ref.h"
+
+/**
+ * @brief Lazy reference to the binary property (PHOTO, LOGO, SOUND, KEY).
+ * Keeps the property line as it is in the source (possibly folded) and the owner of the source
+ * memory (mapped file or shared buffer), so the line is neither copied nor decoded while parsing.
+ * The value is decoded directly from the folded source, segment by segment, only when requested.
+ * Immutable, shared between copies of the property.
+ */
+class vCardBlob {
+public:
+    /**
+     * @param owner Keeps the memory of the line alive
+     * @param line Whole property line in the source, folds are allowed
+     * @param value_offset Offset of the value in the line
+     * @param base64 The value is base64 encoded (ENCODING=b or ENCODING=BASE64 parameter)
+     */
+    vCardBlob(std::shared_ptr<const void> owner, vCardStringRef line, size_t value_offset, bool base64):
+        m_owner(std::move(owner)), m_line(line), m_valueOffset(value_offset), m_base64(base64), m_binary(false) {}
+
+    /**
+     * Creates the blob owning a copy of the line, used when the source memory is transient (streams)
+     */
+    static std::shared_ptr<const vCardBlob> copy(vCardStringRef line, size_t value_offset, bool base64);
+
+    /**
+     * Creates the blob from binary data, the data is base64 encoded only on output
+     */
+    static std::shared_ptr<const vCardBlob> fromData(std::string data);
+
+    /**
+     * Returns the property line as it is in the source, empty for blobs created from data
+     */
+    vCardStringRef source() const { return m_binary ? vCardStringRef() : m_line; }
+
+    /**
+     * Returns unfolded, not decoded property value (e.g. base64 text or URI)
+     */
+    std::string value() const;
+
+    /**
+     * Writes value() to the stream without materializing it
+     */
+    void writeValue(std::ostream& os) const;
+
+    /**
+     * Appends value() to `out`, the data of binary blobs is encoded directly into it
+     */
+    void appendValue(std::string& out) const;
+
+    /**
+     * Returns decoded binary data, see decodeValue()
+     */
+    std::string decode() const;
+
+    /**
+     * Decodes inline binary value: base64 if `base64` is set or the value is "data:" URI
+     * with ";base64," marker. Other values (URIs) are returned as is.
+     * @throws std::runtime_error Is thrown on malformed base64 data
+     */
+    static std::string decodeValue(vCardStringRef value, bool base64);
+
+    /**
+     * Returns true for values of ENCODING parameter which mean base64 ("b" and "BASE64")
+     */
+    static bool isBase64Encoding(vCardStringRef encoding);
+
+protected:
+    template<class Func> void forEachSegment(Func func) const;
+
+    std::shared_ptr<const void> m_owner;
+    vCardStringRef m_line;      // property line or binary data (m_binary)
+    size_t m_valueOffset;
+    bool m_base64;
+    bool m_binary;
+};
+
+#endif //VCARD_BLOB_H
@@ -20,11 +20,18 @@
 #define VCARD_XML_IO_H
 
 #include <istream>
+#include <memory>
 #include "vcard.h"
+#include "output_sink.h"
 
 class XmlWriter {
 public:
-    XmlWriter(std::ostream& os /*, vCvCardEncoding code = UTF_8*/): m_os(&os) {}
+    XmlWriter(std::ostream& os /*, vCvCardEncoding code = UTF_8*/);
+
+    /**
+     * The sink gets the output by blocks, so flush() it after writing
+     */
+    explicit XmlWriter(vCardOutputSink& sink): m_sink(&sink) {}
     ~XmlWriter() {}
 
     XmlWriter & operator << (vCard & vCard);
@@ -32,8 +39,25 @@ public:
     XmlWriter & operator << (vCardProperty & prop);
     XmlWriter & operator << (vCardParamMap & param);
 
+    /**
+     * Writes the cards formatted on `threads` threads (0 - number of cores), the output is the
+     * same as of operator << (std::vector<vCard>&)
+     */
+    XmlWriter & write(std::vector<vCard> & cards, unsigned threads);
+
 protected:
-    std::ostream *m_os;
+    void writeCards(std::vector<vCard>& cards, size_t begin, size_t end);
+    void writeCard(vCard& card);
+    void writeProperty(vCardProperty& prop);
+    void writeParams(vCardParamMap& params);
+
+    /**
+     * Flushes the stream sink, other sinks are flushed only when their block is filled
+     */
+    void finishOutput();
+
+    vCardOutputSink *m_sink;
+    std::unique_ptr<vCardOutputSink> m_ownSink;     // sink of the stream
 
     std::string get_property_type(std::string property_name, int count);
 };
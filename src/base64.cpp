@@ -0,0 +1,336 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <algorithm>
+#include <stdexcept>
+#include "base64.h"
+#include "simd.h"
+
+namespace {
+
+const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// 0-63 - sextet value, 64 - skipped (whitespace), 65 - padding, 255 - invalid
+const unsigned char SKIP = 64;
+const unsigned char PAD = 65;
+const unsigned char INVALID = 255;
+
+struct DecodeTable {
+    unsigned char v[256];
+
+    DecodeTable()
+    {
+        std::fill(v, v + 256, INVALID);
+        for(int i = 0; i < 64; i++)
+            v[static_cast<unsigned char>(alphabet[i])] = i;
+        v[' '] = v['\t'] = v['\r'] = v['\n'] = SKIP;
+        v['='] = PAD;
+    }
+};
+
+const DecodeTable decodeTable;
+
+/**
+ * Vectorized parts decode (or encode) whole blocks from the beginning of the input
+ * and return the number of consumed input characters, the output must have 8 bytes of slack
+ */
+typedef size_t (*CodecFunc)(const char *src, size_t size, char *dst);
+
+size_t decodeNone(const char *, size_t, char *)
+{
+    return 0;
+}
+
+void encodeScalar(const unsigned char *src, size_t size, char *dst)
+{
+    size_t i = 0;
+    for(; i + 3 <= size; i += 3)
+    {
+        unsigned int v = (src[i] << 16) | (src[i + 1] << 8) | src[i + 2];
+        *dst++ = alphabet[v >> 18];
+        *dst++ = alphabet[(v >> 12) & 63];
+        *dst++ = alphabet[(v >> 6) & 63];
+        *dst++ = alphabet[v & 63];
+    }
+
+    if(i + 1 == size)
+    {
+        unsigned int v = src[i] << 16;
+        *dst++ = alphabet[v >> 18];
+        *dst++ = alphabet[(v >> 12) & 63];
+        *dst++ = '=';
+        *dst++ = '=';
+    }
+    else if(i + 2 == size)
+    {
+        unsigned int v = (src[i] << 16) | (src[i + 1] << 8);
+        *dst++ = alphabet[v >> 18];
+        *dst++ = alphabet[(v >> 12) & 63];
+        *dst++ = alphabet[(v >> 6) & 63];
+        *dst++ = '=';
+    }
+}
+
+#ifdef VC_SIMD_AVX2
+/**
+ * 32 characters into 24 bytes, the block with any character outside of the alphabet
+ * (whitespace, padding) stops the loop. See W. Mula, D. Lemire "Faster Base64 Encoding
+ * and Decoding Using AVX2 Instructions".
+ */
+VC_TARGET_AVX2 size_t decodeAvx2(const char *src, size_t size, char *dst)
+{
+    const __m256i lut_lo = _mm256_setr_epi8(
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+            0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i pack_shuffle = _mm256_setr_epi8(
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+            2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+
+    size_t done = 0;
+    while(size - done >= 32)
+    {
+        __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + done));
+
+        // classify by nibbles: both lookups have a common bit only for invalid characters
+        __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+        __m256i lo_nibbles = _mm256_and_si256(str, mask_2f);
+        __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        if(!_mm256_testz_si256(lo, hi))
+            break;
+
+        // characters to sextets
+        __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+        __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+        str = _mm256_add_epi8(str, roll);
+
+        // 4 sextets into 3 bytes in each 32-bit lane, then bytes are packed together
+        __m256i merged = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+        merged = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        merged = _mm256_shuffle_epi8(merged, pack_shuffle);
+        merged = _mm256_permutevar8x32_epi32(merged, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + done / 4 * 3), merged);
+        done += 32;
+    }
+
+    return done;
+}
+
+/**
+ * 24 bytes into 32 characters, reads 28 bytes of the input
+ */
+VC_TARGET_AVX2 size_t encodeAvx2(const char *src, size_t size, char *dst)
+{
+    // every 3 bytes a, b, c are spread to 4 bytes b, a, c, b
+    const __m256i spread = _mm256_setr_epi8(
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+            1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    // offsets to ASCII for ranges of sextets: a-z, 0-9 (10 entries), '+', '/', A-Z
+    const __m256i shift_lut = _mm256_setr_epi8(
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+            'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+            '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+
+    size_t done = 0;
+    while(size - done >= 28)
+    {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + done));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + done + 12));
+        __m256i in = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        in = _mm256_shuffle_epi8(in, spread);
+
+        // extract sextets into separate bytes
+        __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(t1, t3);
+
+        // sextets to ASCII
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        range = _mm256_or_si256(range, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        __m256i result = _mm256_add_epi8(_mm256_shuffle_epi8(shift_lut, range), indices);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + done / 3 * 4), result);
+        done += 24;
+    }
+
+    return done;
+}
+#endif
+
+CodecFunc selectDecode()
+{
+#ifdef VC_SIMD_AVX2
+    if(cpuHasAvx2())
+        return decodeAvx2;
+#endif
+    return decodeNone;
+}
+
+CodecFunc selectEncode()
+{
+#ifdef VC_SIMD_AVX2
+    if(cpuHasAvx2())
+        return encodeAvx2;
+#endif
+    return decodeNone;
+}
+
+const CodecFunc decodeImpl = selectDecode();
+const CodecFunc encodeImpl = selectEncode();
+
+// after the vectorized block fails, scalar decoding passes this number of characters (and the rest of the quantum)
+const size_t VC_SCALAR_RUN = 1;
+
+} // namespace
+
+const char *Base64Decoder::decodeScalar(const char *p, const char *end, char *&dst, size_t min_run)
+{
+    // at least min_run characters, then up to the end of the started quantum
+    const char *limit = p + std::min<size_t>(min_run, end - p);
+    while(p != end && (p < limit || m_count != 0))
+    {
+        unsigned char v = decodeTable.v[static_cast<unsigned char>(*p++)];
+        if(v < 64)
+        {
+            m_bits = (m_bits << 6) | v;
+            if(++m_count == 4)
+            {
+                *dst++ = static_cast<char>(m_bits >> 16);
+                *dst++ = static_cast<char>(m_bits >> 8);
+                *dst++ = static_cast<char>(m_bits);
+                m_bits = 0;
+                m_count = 0;
+            }
+        }
+        else if(v == PAD)
+        {
+            // the padding completes the quantum of 2 or 3 characters
+            if(m_count < 2)
+                throw std::runtime_error("Invalid base64 padding");
+            m_done = true;
+            m_pads = 1;
+            return checkPadding(p, end);
+        }
+        else if(v == INVALID)
+            throw std::runtime_error("Invalid base64 data");
+    }
+
+    return p;
+}
+
+const char *Base64Decoder::checkPadding(const char *p, const char *end)
+{
+    for(; p != end; p++)
+    {
+        unsigned char v = decodeTable.v[static_cast<unsigned char>(*p)];
+        if(v == PAD)
+        {
+            if(m_count + ++m_pads > 4)
+                throw std::runtime_error("Invalid base64 padding");
+        }
+        else if(v != SKIP)
+            throw std::runtime_error("Invalid base64 data after padding");
+    }
+
+    return p;
+}
+
+void Base64Decoder::update(vCardStringRef input, std::string& out)
+{
+    if(m_done)
+    {
+        checkPadding(input.begin(), input.end());
+        return;
+    }
+
+    // enough for the whole input and the vectorized store slack
+    size_t size = out.size();
+    out.resize(size + (input.size() + 3) / 4 * 3 + 32);
+    char *dst = &out[size];
+
+    // complete the quantum started by the previous part (e.g. before the fold)
+    const char *p = decodeScalar(input.begin(), input.end(), dst, 0), *end = input.end();
+    while(p != end && !m_done)
+    {
+        if(end - p >= 32)
+        {
+            size_t consumed = decodeImpl(p, end - p, dst);
+            dst += consumed / 4 * 3;
+            p += consumed;
+        }
+
+        // whitespaces, padding and the tail shorter than the block
+        p = decodeScalar(p, end, dst, VC_SCALAR_RUN);
+    }
+
+    out.resize(dst - &out[0]);
+}
+
+void Base64Decoder::finish(std::string& out)
+{
+    // one character has only 6 bits, less than a byte
+    if(m_count == 1)
+        throw std::runtime_error("Truncated base64 data");
+
+    if(m_count == 2)
+        out += static_cast<char>(m_bits >> 4);
+    else if(m_count == 3)
+    {
+        out += static_cast<char>(m_bits >> 10);
+        out += static_cast<char>(m_bits >> 2);
+    }
+
+    m_bits = 0;
+    m_count = 0;
+    m_pads = 0;
+    m_done = true;
+}
+
+std::string base64Decode(vCardStringRef input)
+{
+    std::string result;
+    result.reserve(input.size() / 4 * 3 + 3);
+
+    Base64Decoder decoder;
+    decoder.update(input, result);
+    decoder.finish(result);
+    return result;
+}
+
+void base64Encode(vCardStringRef data, std::string& out)
+{
+    size_t size = out.size();
+    out.resize(size + base64EncodedSize(data.size()) + 8);
+
+    size_t consumed = encodeImpl(data.data(), data.size(), &out[size]);
+    encodeScalar(reinterpret_cast<const unsigned char*>(data.data()) + consumed, data.size() - consumed,
+                 &out[size + consumed / 3 * 4]);
+
+    out.resize(size + base64EncodedSize(data.size()));
+}
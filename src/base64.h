@@ -0,0 +1,76 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef VCARD_BASE64_H
+#define VCARD_BASE64_H
+
+#include <string>
+#include "string_ref.h"
+
+/**
+ * @brief Incremental base64 decoder. The input may be split at any position
+ * (e.g. by folds of the property line), whitespaces and line breaks are skipped,
+ * '=' ends the data, only whitespaces and the rest of the padding may follow it.
+ * Uses AVX2 when available.
+ */
+class Base64Decoder {
+public:
+    Base64Decoder(): m_bits(0), m_count(0), m_pads(0), m_done(false) {}
+
+    /**
+     * Decodes the next part of the input and appends the result to `out`
+     * @throws std::runtime_error Is thrown on characters outside of base64 alphabet, misplaced
+     * padding or data after the padding
+     */
+    void update(vCardStringRef input, std::string& out);
+
+    /**
+     * Appends the bytes of the last incomplete quantum (input without padding)
+     * @throws std::runtime_error Is thrown if the input ends with a single character of the quantum
+     */
+    void finish(std::string& out);
+
+protected:
+    // scalar decoding of [p, end), returns pointer where the decoding stopped
+    const char *decodeScalar(const char *p, const char *end, char *&dst, size_t min_run);
+
+    // checks that only whitespaces and the rest of the padding follow '='
+    const char *checkPadding(const char *p, const char *end);
+
+    unsigned int m_bits;
+    int m_count;
+    int m_pads;
+    bool m_done;
+};
+
+/**
+ * Decodes whole base64 text, see Base64Decoder
+ */
+std::string base64Decode(vCardStringRef input);
+
+/**
+ * Appends base64 encoding of the data (with padding, without line breaks) to `out`.
+ * Uses AVX2 when available.
+ */
+void base64Encode(vCardStringRef data, std::string& out);
+
+static inline size_t base64EncodedSize(size_t size)
+{
+    return (size + 2) / 3 * 4;
+}
+
+#endif //VCARD_BASE64_H
@@ -0,0 +1,209 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <vector>
+#include "charset.h"
+#include "charset_tables.h"
+#include "simd.h"
+
+namespace {
+
+const unsigned VC_REPLACEMENT_CHAR = 0xFFFD;
+
+int hexValue(char c)
+{
+    if(c >= '0' && c <= '9')
+        return c - '0';
+    if(c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if(c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+void appendUtf8(unsigned cp, std::string& out)
+{
+    if(cp < 0x80)
+    {
+        out.push_back(static_cast<char>(cp));
+    }
+    else if(cp < 0x800)
+    {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+    else
+    {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+/**
+ * Returns pointer to the first byte >= 0x80 in [p, end) or end, ASCII is checked by 16 bytes
+ */
+const char *skipAscii(const char *p, const char *end)
+{
+#ifdef VC_SIMD_SSE2
+    for(; end - p >= 16; p += 16)
+    {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        if(mask != 0)
+            return p + countTrailingZeros(mask);
+    }
+#endif
+    while(p < end && static_cast<unsigned char>(*p) < 0x80)
+        p++;
+    return p;
+}
+
+/**
+ * Uppercase name without '-' and '_', so "iso-8859-1", "ISO8859-1" and "ISO_8859-1" are the same
+ */
+std::string normalizedName(vCardStringRef name)
+{
+    std::string result;
+    result.reserve(name.size());
+    for(char c : name)
+    {
+        if(c == '-' || c == '_')
+            continue;
+        if(c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        result.push_back(c);
+    }
+    return result;
+}
+
+} // namespace
+
+// =================================================================
+
+void decodeQuotedPrintable(vCardStringRef input, std::string& out)
+{
+    out.reserve(out.size() + input.size());
+
+    size_t pos = 0;
+    while(pos < input.size())
+    {
+        // fast path: runs without '=' are copied as a whole, memchr is vectorized
+        size_t eq = input.find('=', pos);
+        if(eq == vCardStringRef::npos)
+        {
+            out.append(input.data() + pos, input.size() - pos);
+            break;
+        }
+        out.append(input.data() + pos, eq - pos);
+        pos = eq + 1;
+
+        if(pos < input.size() && (input[pos] == '\r' || input[pos] == '\n'))
+        {
+            // soft line break
+            if(input[pos] == '\r' && pos + 1 < input.size() && input[pos + 1] == '\n')
+                pos++;
+            pos++;
+            continue;
+        }
+
+        int hi = pos + 1 < input.size() ? hexValue(input[pos]) : -1;
+        int lo = hi >= 0 ? hexValue(input[pos + 1]) : -1;
+        if(lo < 0)
+        {
+            out.push_back('=');
+            continue;
+        }
+
+        out.push_back(static_cast<char>((hi << 4) | lo));
+        pos += 2;
+    }
+}
+
+// =================================================================
+
+const Charset* Charset::find(vCardStringRef name)
+{
+    static const Charset utf8(UTF8, nullptr);
+    static const Charset shift_jis(SHIFT_JIS, nullptr);
+    static const std::vector<Charset> single_byte = [](){
+        std::vector<Charset> charsets;
+        for(size_t i = 0; i < single_byte_charsets_count; i++)
+            charsets.push_back(Charset(SINGLE_BYTE, single_byte_charsets[i].high));
+        return charsets;
+    }();
+
+    std::string normalized = normalizedName(name);
+    if(normalized == "UTF8" || normalized == "USASCII" || normalized == "ASCII")
+        return &utf8;
+    if(normalized == "SHIFTJIS" || normalized == "SJIS" || normalized == "CP932"
+            || normalized == "WINDOWS31J" || normalized == "MSKANJI")
+        return &shift_jis;
+
+    for(size_t i = 0; i < single_byte_charsets_count; i++)
+    {
+        if(normalized == single_byte_charsets[i].name)
+            return &single_byte[i];
+    }
+
+    return nullptr;
+}
+
+void Charset::toUtf8(vCardStringRef input, std::string& out) const
+{
+    if(m_kind == UTF8)
+    {
+        out.append(input.data(), input.size());
+        return;
+    }
+
+    out.reserve(out.size() + input.size() + input.size() / 2);
+
+    const char *p = input.begin(), *end = input.end();
+    while(p < end)
+    {
+        const char *ascii_end = skipAscii(p, end);
+        out.append(p, ascii_end - p);
+        p = ascii_end;
+        if(p == end)
+            break;
+
+        unsigned char c = static_cast<unsigned char>(*p++);
+        if(m_kind == SINGLE_BYTE)
+        {
+            appendUtf8(m_high[c - 0x80], out);
+            continue;
+        }
+
+        // Shift-JIS: half-width katakana or double byte character
+        if(c >= 0xA1 && c <= 0xDF)
+        {
+            appendUtf8(0xFF61 + (c - 0xA1), out);
+            continue;
+        }
+
+        unsigned lead = sjis_lead_index[c];
+        unsigned char trail = p < end ? static_cast<unsigned char>(*p) : 0;
+        if(lead == 0xFF || trail < SJIS_TRAIL_FIRST || trail > SJIS_TRAIL_LAST)
+        {
+            appendUtf8(VC_REPLACEMENT_CHAR, out);
+            continue;
+        }
+
+        appendUtf8(sjis_table[lead * (SJIS_TRAIL_LAST - SJIS_TRAIL_FIRST + 1) + trail - SJIS_TRAIL_FIRST], out);
+        p++;
+    }
+}
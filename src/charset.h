@@ -0,0 +1,67 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef VCARD_CHARSET_H
+#define VCARD_CHARSET_H
+
+#include <cstdint>
+#include <string>
+#include "string_ref.h"
+
+/**
+ * Decodes quoted-printable text and appends the result to `out`.
+ * Soft line breaks ("=" before the line end) are removed, invalid escapes are kept as is.
+ */
+void decodeQuotedPrintable(vCardStringRef input, std::string& out);
+
+/**
+ * @brief Legacy charset of vCard 2.1 values (CHARSET parameter), converts text to UTF-8.
+ * Single byte charsets and Shift-JIS use tables from charset_tables.cpp.
+ */
+class Charset {
+public:
+    /**
+     * Finds charset by name ("Windows-1251", "ISO-8859-1", "SHIFT_JIS", ...), case,
+     * '-' and '_' are ignored.
+     * @return nullptr for unknown charsets
+     */
+    static const Charset* find(vCardStringRef name);
+
+    /**
+     * UTF-8 and US-ASCII, the text is not converted
+     */
+    bool isUtf8() const { return m_kind == UTF8; }
+
+    /**
+     * Appends the text converted to UTF-8 to `out`, undefined bytes are replaced with U+FFFD
+     */
+    void toUtf8(vCardStringRef input, std::string& out) const;
+
+protected:
+    enum Kind {
+        UTF8,
+        SINGLE_BYTE,
+        SHIFT_JIS
+    };
+
+    Charset(Kind kind, const uint16_t *high): m_kind(kind), m_high(high) {}
+
+    Kind m_kind;
+    const uint16_t *m_high;
+};
+
+#endif //VCARD_CHARSET_H
@@ -0,0 +1,40 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef VCARD_CHARSET_TABLES_H
+#define VCARD_CHARSET_TABLES_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Tables are generated by tools/gen_charset_tables.py
+
+struct SingleByteCharset {
+    const char *name;           // uppercase, without '-' and '_'
+    const uint16_t *high;       // code points of bytes 0x80-0xFF, 0xFFFD for undefined
+};
+
+extern const SingleByteCharset single_byte_charsets[];
+extern const size_t single_byte_charsets_count;
+
+// Shift-JIS (CP932): index of the lead byte or 0xFF, code points of [lead index][trail - 0x40]
+const unsigned SJIS_TRAIL_FIRST = 0x40;
+const unsigned SJIS_TRAIL_LAST = 0xFC;
+extern const uint8_t sjis_lead_index[256];
+extern const uint16_t sjis_table[];
+
+#endif //VCARD_CHARSET_TABLES_H
@@ -0,0 +1,167 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "json_escape.h"
+#include "simd.h"
+
+namespace {
+
+inline bool isJsonSpecial(unsigned char c)
+{
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+const char *findJsonSpecialScalar(const char *p, const char *end)
+{
+    while(p != end && !isJsonSpecial(static_cast<unsigned char>(*p)))
+        p++;
+    return p;
+}
+
+#ifdef VC_SIMD_SSE2
+const char *findJsonSpecialSse2(const char *p, const char *end)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i slash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    while(end - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // unsigned v <= 0x1F
+        __m128i low = _mm_cmpeq_epi8(_mm_max_epu8(v, control), control);
+        __m128i special = _mm_or_si128(low, _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash)));
+        int mask = _mm_movemask_epi8(special);
+        if(mask)
+            return p + countTrailingZeros(mask);
+        p += 16;
+    }
+
+    return findJsonSpecialScalar(p, end);
+}
+#endif
+
+#ifdef VC_SIMD_AVX2
+VC_TARGET_AVX2 const char *findJsonSpecialAvx2(const char *p, const char *end)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i slash = _mm256_set1_epi8('\\');
+    const __m256i control = _mm256_set1_epi8(0x1F);
+    while(end - p >= 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        __m256i low = _mm256_cmpeq_epi8(_mm256_max_epu8(v, control), control);
+        __m256i special = _mm256_or_si256(low, _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                                                _mm256_cmpeq_epi8(v, slash)));
+        unsigned mask = _mm256_movemask_epi8(special);
+        if(mask)
+            return p + countTrailingZeros(mask);
+        p += 32;
+    }
+
+    return findJsonSpecialScalar(p, end);
+}
+#endif
+
+typedef const char *(*FindJsonSpecialFunc)(const char *, const char *);
+
+FindJsonSpecialFunc selectFindJsonSpecial()
+{
+#ifdef VC_SIMD_AVX2
+    if(cpuHasAvx2())
+        return findJsonSpecialAvx2;
+#endif
+#ifdef VC_SIMD_SSE2
+    return findJsonSpecialSse2;
+#else
+    return findJsonSpecialScalar;
+#endif
+}
+
+const FindJsonSpecialFunc findJsonSpecialImpl = selectFindJsonSpecial();
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+} // namespace
+
+const char *findJsonSpecial(const char *p, const char *end)
+{
+    return findJsonSpecialImpl(p, end);
+}
+
+void appendJsonString(vCardStringRef value, bool unescape, std::string& out)
+{
+    out += '"';
+    const char *p = value.data(), *end = p + value.size();
+    for(;;)
+    {
+        const char *special = findJsonSpecial(p, end);
+        out.append(p, special - p);
+        if(special == end)
+            break;
+
+        unsigned char c = static_cast<unsigned char>(*special);
+        p = special + 1;
+        switch(c)
+        {
+        case '\\':
+            if(unescape && p != end)
+            {
+                char next = *p;
+                if(next == 'n' || next == 'N')
+                {
+                    out.append("\\n", 2);
+                    p++;
+                    break;
+                }
+                if(next == ',' || next == ';' || next == ':')
+                {
+                    out += next;
+                    p++;
+                    break;
+                }
+                if(next == '\\')
+                    p++;
+            }
+            out.append("\\\\", 2);
+            break;
+        case '"':
+            out.append("\\\"", 2);
+            break;
+        case '\n':
+            out.append("\\n", 2);
+            break;
+        case '\r':
+            out.append("\\r", 2);
+            break;
+        case '\t':
+            out.append("\\t", 2);
+            break;
+        case '\b':
+            out.append("\\b", 2);
+            break;
+        case '\f':
+            out.append("\\f", 2);
+            break;
+        default:
+            out.append("\\u00", 4);
+            out += HEX_DIGITS[c >> 4];
+            out += HEX_DIGITS[c & 15];
+        }
+    }
+    out += '"';
+}
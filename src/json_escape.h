@@ -0,0 +1,38 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef VCARD_JSON_ESCAPE_H
+#define VCARD_JSON_ESCAPE_H
+
+#include <string>
+#include "string_ref.h"
+
+/**
+ * Returns pointer to the first byte in [p, end) which has to be escaped in JSON string
+ * ('"', '\\' or control character) or end. Uses AVX2 or SSE2 scanner when available,
+ * the implementation is selected at runtime
+ */
+const char *findJsonSpecial(const char *p, const char *end);
+
+/**
+ * Appends the value as quoted JSON string (RFC 8259), runs without special characters
+ * are copied in bulk.
+ * @param unescape vCard text escapes ("\n", "\,", "\;", "\\") are decoded first
+ */
+void appendJsonString(vCardStringRef value, bool unescape, std::string& out);
+
+#endif //VCARD_JSON_ESCAPE_H
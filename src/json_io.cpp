@@ -17,95 +17,338 @@
  */
 
 #include <algorithm>
+#include <cctype>
+#include <cstring>
 #include "json_io.h"
+#include "vcard_blob.h"
 #include "utils.h"
+#include "json_escape.h"
+#include "parallel_writer.h"
+#include "property_names.h"
 
+namespace {
 
-JsonWriter & JsonWriter::operator << (vCard & vCard)
+/**
+ * Default value types of RFC 6350 properties, other properties are text
+ */
+const char *defaultValueType(PropertyId id)
+{
+    switch(id){
+    case VC_ID_SOURCE: case VC_ID_PHOTO: case VC_ID_TEL: case VC_ID_IMPP: case VC_ID_GEO:
+    case VC_ID_LOGO: case VC_ID_MEMBER: case VC_ID_RELATED: case VC_ID_SOUND: case VC_ID_UID:
+    case VC_ID_URL: case VC_ID_KEY: case VC_ID_FBURL: case VC_ID_CALADRURI: case VC_ID_CALURI:
+        return "uri";
+    case VC_ID_BDAY: case VC_ID_ANNIVERSARY:
+        return "date-and-or-time";
+    case VC_ID_REV:
+        return "timestamp";
+    case VC_ID_LANG:
+        return "language-tag";
+    default:
+        return "text";
+    }
+}
+
+inline bool isStructured(PropertyId id)
+{
+    return id == VC_ID_N || id == VC_ID_ADR || id == VC_ID_ORG || id == VC_ID_GENDER || id == VC_ID_CLIENTPIDMAP;
+}
+
+inline bool isList(PropertyId id)
 {
-    *m_os << "[\"vcard\", [";
+    return id == VC_ID_NICKNAME || id == VC_ID_CATEGORIES;
+}
 
-    *m_os << "[\"version\", {}, \"text\", \"4.0\"],";
-    for(auto it = vCard.properties().begin(); it != vCard.properties().end(); ++it){
-        *this << *it;
+/**
+ * Media type prefix of "data:" URI for the inline binary value, the TYPE parameter follows
+ */
+const char *mediaType(PropertyId id)
+{
+    switch(id){
+    case VC_ID_PHOTO: case VC_ID_LOGO:
+        return "image/";
+    case VC_ID_SOUND:
+        return "audio/";
+    default:
+        return "application/";
     }
+}
 
-    *m_os << "]]";
-    return *this;
+/**
+ * Starts with URI scheme (RFC 3986): ALPHA *( ALPHA / DIGIT / "+" / "-" / "." ) ":"
+ */
+bool isUri(vCardStringRef value)
+{
+    if(value.empty() || !std::isalpha(static_cast<unsigned char>(value[0])))
+        return false;
+
+    for(size_t i = 1; i < value.size(); i++){
+        unsigned char c = value[i];
+        if(c == ':')
+            return true;
+        if(!std::isalnum(c) && c != '+' && c != '-' && c != '.')
+            return false;
+    }
+    return false;
 }
 
-JsonWriter & JsonWriter::operator << (std::vector<vCard> & cards)
+bool isBase64(vCardParamMap& params)
 {
-    *m_os << "[";
+    auto range = params.getParams("ENCODING");
+    for(auto it = range.first; it != range.second; ++it)
+        if(vCardBlob::isBase64Encoding(it->second))
+            return true;
+    return false;
+}
 
-    for(auto card: cards){
-        *this << card;
+void appendLower(vCardStringRef s, std::string& out)
+{
+    for(size_t i = 0; i < s.size(); i++){
+        char c = s[i];
+        out += (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
     }
+}
 
-    *m_os << "]";
+} // namespace
 
+
+JsonWriter::JsonWriter(std::ostream& os):
+    m_ownSink(new vCardStreamSink(os))
+{
+    m_sink = m_ownSink.get();
+}
+
+JsonWriter & JsonWriter::operator << (vCard & vCard)
+{
+    writeCard(vCard);
+    finishOutput();
     return *this;
 }
 
-JsonWriter & JsonWriter::operator << (vCardProperty & p)
+JsonWriter & JsonWriter::operator << (std::vector<vCard> & cards)
+{
+    return write(cards, 1);
+}
+
+JsonWriter & JsonWriter::write(std::vector<vCard> & cards, unsigned threads)
 {
-    *m_os << "[";
+    *m_sink << "[";
 
-    std::string name(p.getName());
-    tolower(name);
+    bool parallel = writeCardsParallel(cards.size(), threads, *m_sink,
+                                       [&cards](size_t begin, size_t end, std::string& out){
+        vCardStringSink sink(out);
+        JsonWriter(sink).writeCards(cards, begin, end);
+    });
+    if(!parallel)
+        writeCards(cards, 0, cards.size());
 
-    *m_os << "\"" << name << "\", ";
-    *this << p.params();
-    *m_os << ", ";
+    *m_sink << "]";
+    finishOutput();
 
-    *m_os << "\"" << get_property_type(name) << "\", ";
+    return *this;
+}
 
-    if(p.values().size() > 1)
-        *m_os << "[";
+JsonWriter & JsonWriter::operator << (vCardProperty & p)
+{
+    writeProperty(p);
+    finishOutput();
+    return *this;
+}
+
+JsonWriter & JsonWriter::operator << (vCardParamMap & p)
+{
+    writeParams(p, std::string(), false);
+    finishOutput();
+    return *this;
+}
 
-    auto it = p.values().begin();
-    while(it != p.values().end()){
-        *m_os << "\"" << *it << "\"";
+void JsonWriter::writeCards(std::vector<vCard>& cards, size_t begin, size_t end)
+{
+    for(size_t i = begin; i < end; i++){
+        if(i > 0)
+            *m_sink << ",";
+        writeCard(cards[i]);
+        m_sink->commit();
+    }
+}
 
-        it++;
+void JsonWriter::writeCard(vCard & vCard)
+{
+    std::string& out = m_sink->buffer();
 
-        if(it != p.values().end())
-            *m_os << ", ";
+    // the output of the card is allocated at once, escapes rarely exceed the estimate
+    size_t size = 64;
+    for(vCardProperty& p : vCard.properties()){
+        size += 32 + p.getName().size() + p.getGroup().size() + p.valueSize();
+        for(const vCardParam& param : p.params())
+            size += 8 + param.first.str().size() + param.second.size();
     }
+    if(out.capacity() < out.size() + size)
+        out.reserve(std::max(out.size() + size, out.capacity() * 2));
 
-    if(p.values().size() > 1)
-        *m_os << "]";
+    out.append("[\"vcard\", [[\"version\", {}, \"text\", \"");
+    out.append(vCard.getVersionStr());
+    out.append("\"]");
+    for(vCardProperty& p : vCard.properties()){
+        out.append(", ");
+        writeProperty(p);
+    }
 
-    *m_os << "]";
-    return *this;
+    out.append("]]");
 }
 
-std::string JsonWriter::get_property_type(std::string property_name)
+void JsonWriter::writeProperty(vCardProperty & p)
 {
-    std::string type("text");
-    tolower(property_name);
+    std::string& out = m_sink->buffer();
+    PropertyId id = propertyId(p.getName());
+    bool binary = isBase64(p.params());
+    vCardStringRef value;
+    std::string blob_value;
+    if(p.isBlob() && !binary){
+        blob_value = p.getBlob()->value();
+        value = blob_value;
+    }
+    else if(!p.isBlob())
+        value = p.getValue();
+
+    out.append("[\"");
+    appendLower(p.getName(), out);
+    out.append("\", ");
+    writeParams(p.params(), p.getGroup(), binary);
+    out.append(", \"");
+
+    // the type is the VALUE parameter or the default of the property
+    const char *type = defaultValueType(id);
+    auto value_param = p.params().getParams("VALUE");
+    if(binary)
+        type = "uri";
+    else if(value_param.first != value_param.second)
+        type = nullptr;
+    else if(std::strcmp(type, "uri") == 0 && !isUri(value))
+        type = "text";
 
-    if(vCardProperty::property_types.find(property_name) != vCardProperty::property_types.end())
-        type = vCardProperty::property_types.at(property_name);
+    bool text;
+    if(type){
+        out.append(type);
+        text = std::strcmp(type, "text") == 0;
+    }
+    else{
+        appendLower(value_param.first->second, out);
+        text = vCardStringRef(value_param.first->second).equalsNoCase("text");
+    }
+    out.append("\", ");
+
+    if(binary){
+        // base64 has no characters to escape
+        out.append("\"data:");
+        auto media = p.params().getParams("TYPE");
+        if(media.first != media.second){
+            out.append(mediaType(id));
+            appendLower(media.first->second, out);
+        }
+        else
+            out.append("application/octet-stream");
+        out.append(";base64,");
+        if(p.isBlob())
+            p.getBlob()->appendValue(out);
+        else
+            out.append(value.data(), value.size());
+        out += '"';
+    }
+    else if(text && isStructured(id)){
+        // components of N and ADR can be lists
+        bool lists = id == VC_ID_N || id == VC_ID_ADR;
+        value.split(VC_SEPARATOR_TOKEN, true, m_components);
+        out += '[';
+        for(size_t i = 0; i < m_components.size(); i++){
+            if(i > 0)
+                out.append(", ");
+            if(lists)
+                m_components[i].split(',', true, m_items);
+            if(lists && m_items.size() > 1){
+                out += '[';
+                for(size_t j = 0; j < m_items.size(); j++){
+                    if(j > 0)
+                        out.append(", ");
+                    appendJsonString(m_items[j], true, out);
+                }
+                out += ']';
+            }
+            else
+                appendJsonString(m_components[i], true, out);
+        }
+        out += ']';
+    }
+    else if(text && isList(id)){
+        // multiple values follow the type
+        value.split(',', true, m_items);
+        for(size_t i = 0; i < m_items.size(); i++){
+            if(i > 0)
+                out.append(", ");
+            appendJsonString(m_items[i], true, out);
+        }
+    }
+    else
+        appendJsonString(value, text, out);
 
-    return type;
+    out += ']';
 }
 
-JsonWriter & JsonWriter::operator << (vCardParamMap & p)
+void JsonWriter::writeParams(vCardParamMap & p, const std::string& group, bool binary)
 {
-    *m_os << "{";
+    std::string& out = m_sink->buffer();
+    out += '{';
+
+    bool first = true;
+    if(!group.empty()){
+        out.append("\"group\": ");
+        appendJsonString(group, false, out);
+        first = false;
+    }
 
+    // parameters with the same name are adjacent, they are written as an array
     auto it = p.begin();
     while(it != p.end()){
-        *m_os << "\"" << it->first << "\": \"" << it->second << "\"";
+        auto next = it + 1;
+        while(next != p.end() && next->first == it->first)
+            next++;
+
+        vCardStringRef name(it->first.str());
+        bool skip = name.equalsNoCase("VALUE") ||
+                    (binary && (name.equalsNoCase("ENCODING") || name.equalsNoCase("TYPE")));
+        if(!skip){
+            if(!first)
+                out.append(", ");
+            first = false;
 
-        it++;
-        if(it != p.end())
-            *m_os << ", ";
+            out += '"';
+            appendLower(name, out);
+            out.append("\": ");
+            if(next - it > 1){
+                out += '[';
+                for(auto v = it; v != next; ++v){
+                    if(v != it)
+                        out.append(", ");
+                    appendJsonString(v->second, false, out);
+                }
+                out += ']';
+            }
+            else
+                appendJsonString(it->second, false, out);
+        }
+        it = next;
     }
 
-    *m_os << "}";
-    return *this;
+    out += '}';
+}
+
+void JsonWriter::finishOutput()
+{
+    // the output to the stream is visible after every call, own sinks get it by blocks
+    if(m_ownSink)
+        m_sink->flush();
+    else
+        m_sink->commit();
 }
 
 // ================================================================================
@@ -0,0 +1,165 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "line_scanner.h"
+#include "simd.h"
+
+namespace {
+
+const char *findLineEndScalar(const char *p, const char *end)
+{
+    while(p != end && *p != '\n' && *p != '\r')
+        p++;
+    return p;
+}
+
+#ifdef VC_SIMD_SSE2
+const char *findLineEndSse2(const char *p, const char *end)
+{
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+    while(end - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+        if(mask)
+            return p + countTrailingZeros(mask);
+        p += 16;
+    }
+
+    return findLineEndScalar(p, end);
+}
+#endif
+
+#ifdef VC_SIMD_AVX2
+VC_TARGET_AVX2 const char *findLineEndAvx2(const char *p, const char *end)
+{
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    while(end - p >= 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)));
+        if(mask)
+            return p + countTrailingZeros(mask);
+        p += 32;
+    }
+
+    return findLineEndScalar(p, end);
+}
+#endif
+
+typedef const char *(*FindLineEndFunc)(const char *, const char *);
+
+FindLineEndFunc selectFindLineEnd()
+{
+#ifdef VC_SIMD_AVX2
+    if(cpuHasAvx2())
+        return findLineEndAvx2;
+#endif
+#ifdef VC_SIMD_SSE2
+    return findLineEndSse2;
+#else
+    return findLineEndScalar;
+#endif
+}
+
+const FindLineEndFunc findLineEndImpl = selectFindLineEnd();
+
+} // namespace
+
+const char *findLineEnd(const char *p, const char *end)
+{
+    return findLineEndImpl(p, end);
+}
+
+const char *splitLine(const char *begin, const char *end, bool eof, vCardStringRef& line, std::string& unfolded)
+{
+    const char *start = begin;
+    bool folded = false;
+    for(;;)
+    {
+        const char *p = findLineEnd(start, end);
+        const char *next = p;
+        if(p == end)
+        {
+            if(!eof)
+                return nullptr;
+        }
+        else
+        {
+            next = p + 1;
+            if(*p == '\r')
+            {
+                // we need to see the next characters to decide about CRLF and folding
+                if(next == end)
+                {
+                    if(!eof)
+                        return nullptr;
+                }
+                else if(*next == '\n')
+                {
+                    next++;
+                    if(next == end)
+                    {
+                        if(!eof)
+                            return nullptr;
+                    }
+                    else if(isFoldingChar(*next))
+                    {
+                        if(!folded)
+                            unfolded.clear();
+                        unfolded.append(start, p);
+                        folded = true;
+                        start = next + 1;
+                        continue;
+                    }
+                }
+            }
+        }
+
+        if(folded)
+        {
+            unfolded.append(start, p);
+            line = vCardStringRef(unfolded);
+        }
+        else
+            line = vCardStringRef(start, p - start);
+
+        return next;
+    }
+}
+
+size_t foldedOffset(vCardStringRef folded, size_t unfolded_offset)
+{
+    size_t pos = 0;
+    for(;;)
+    {
+        const char *p = findLineEnd(folded.begin() + pos, folded.end());
+        size_t segment = p - folded.begin() - pos;
+        if(unfolded_offset <= segment)
+            return pos + unfolded_offset;
+
+        unfolded_offset -= segment;
+        pos += segment;
+        if(folded.size() - pos >= 3 && p[0] == '\r' && p[1] == '\n' && isFoldingChar(p[2]))
+            pos += 3;
+        else
+            return pos;
+    }
+}
@@ -0,0 +1,53 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VCARD_LINE_SCANNER_H
+#define VCARD_LINE_SCANNER_H
+
+#include <string>
+#include "string_ref.h"
+
+/**
+ * vCard folding: CRLF followed by one of these characters continues the line
+ */
+static inline bool isFoldingChar(char c)
+{
+    return c == ' ' || c == '\t' || c == '=' || c == ';';
+}
+
+/**
+ * Returns pointer to the first '\r' or '\n' in [p, end) or end if there is no line end.
+ * Uses AVX2 or SSE2 scanner when available, the implementation is selected at runtime
+ */
+const char *findLineEnd(const char *p, const char *end);
+
+/**
+ * Splits one logical (unfolded) line from the beginning of [begin, end).
+ * Not folded line is returned as a view into the input, folded line is unfolded into `unfolded`.
+ * @param eof True if there is no more input after `end`
+ * @return Pointer to the beginning of the next line, or nullptr if more input
+ * is needed to complete the line (possible only if eof is false)
+ */
+const char *splitLine(const char *begin, const char *end, bool eof, vCardStringRef& line, std::string& unfolded);
+
+/**
+ * Maps the offset in the unfolded line to the offset in the source (folded) line
+ */
+size_t foldedOffset(vCardStringRef folded, size_t unfolded_offset);
+
+#endif //VCARD_LINE_SCANNER_H
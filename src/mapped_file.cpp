@@ -0,0 +1,160 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "mapped_file.h"
+
+#ifdef _WIN32
+
+namespace {
+
+std::string lastError()
+{
+    return "error " + std::to_string(::GetLastError());
+}
+
+} // namespace
+
+vCardMappedFile::vCardMappedFile(const std::string& path): m_data(nullptr), m_size(0)
+{
+    HANDLE file = ::CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Can not open file " + path + ": " + lastError());
+
+    LARGE_INTEGER size;
+    if(!::GetFileSizeEx(file, &size))
+    {
+        std::string err = lastError();
+        ::CloseHandle(file);
+        throw std::runtime_error("Can not stat file " + path + ": " + err);
+    }
+
+    if(static_cast<unsigned long long>(size.QuadPart) > static_cast<size_t>(-1))
+    {
+        ::CloseHandle(file);
+        throw std::runtime_error("File is too large to be mapped: " + path);
+    }
+
+    m_size = static_cast<size_t>(size.QuadPart);
+    if(m_size > 0)
+    {
+        HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void *p = mapping ? ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, m_size) : nullptr;
+        std::string err = p ? std::string() : lastError();
+        if(mapping)
+            ::CloseHandle(mapping);
+        if(!p)
+        {
+            ::CloseHandle(file);
+            throw std::runtime_error("Can not map file " + path + ": " + err);
+        }
+        m_data = static_cast<const char*>(p);
+    }
+
+    // the view stays valid after the handles are closed
+    ::CloseHandle(file);
+}
+
+vCardMappedFile::~vCardMappedFile()
+{
+    if(m_data)
+        ::UnmapViewOfFile(m_data);
+}
+
+void vCardMappedFile::release(size_t, size_t) const
+{
+    // pages of the read-only view are dropped by the system under memory pressure
+}
+
+#else
+
+vCardMappedFile::vCardMappedFile(const std::string& path): m_data(nullptr), m_size(0)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("Can not open file " + path + ": " + std::strerror(errno));
+
+    struct stat st;
+    if(::fstat(fd, &st) != 0)
+    {
+        int err = errno;
+        ::close(fd);
+        throw std::runtime_error("Can not stat file " + path + ": " + std::strerror(err));
+    }
+
+    if(static_cast<unsigned long long>(st.st_size) > static_cast<size_t>(-1))
+    {
+        ::close(fd);
+        throw std::runtime_error("File is too large to be mapped: " + path);
+    }
+
+    m_size = static_cast<size_t>(st.st_size);
+    if(m_size > 0)
+    {
+        void *p = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED)
+        {
+            int err = errno;
+            ::close(fd);
+            throw std::runtime_error("Can not map file " + path + ": " + std::strerror(err));
+        }
+
+        m_data = static_cast<const char*>(p);
+        ::madvise(p, m_size, MADV_SEQUENTIAL);
+#ifdef POSIX_FADV_SEQUENTIAL
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+}
+
+vCardMappedFile::~vCardMappedFile()
+{
+    if(m_data)
+        ::munmap(const_cast<char*>(m_data), m_size);
+}
+
+void vCardMappedFile::release(size_t offset, size_t length) const
+{
+    if(!m_data || offset >= m_size)
+        return;
+
+    // madvise works with whole pages only
+    size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = std::min(offset + length, m_size) / page * page;
+    if(begin < end)
+        ::madvise(const_cast<char*>(m_data) + begin, end - begin, MADV_DONTNEED);
+}
+
+#endif
@@ -0,0 +1,214 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <ostream>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#include <climits>
+#else
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#include "output_sink.h"
+
+#ifdef _WIN32
+// There is no writev() on Windows, the parts are written one by one with _write()
+struct iovec {
+    void *iov_base;
+    size_t iov_len;
+};
+#endif
+
+namespace {
+
+#ifdef _WIN32
+/**
+ * Writes all parts
+ * @throws std::runtime_error Is thrown if the write fails
+ */
+void writeAll(int fd, struct iovec *parts, int count)
+{
+    for(int i = 0; i < count; i++)
+    {
+        const char *p = static_cast<const char*>(parts[i].iov_base);
+        size_t rest = parts[i].iov_len;
+        while(rest > 0)
+        {
+            int written = ::_write(fd, p, static_cast<unsigned>(std::min<size_t>(rest, INT_MAX)));
+            if(written < 0)
+                throw std::runtime_error(std::string("Write failed: ") + std::strerror(errno));
+            p += written;
+            rest -= static_cast<size_t>(written);
+        }
+    }
+}
+#else
+
+/**
+ * Writes all parts, partial and interrupted writes are continued
+ * @throws std::runtime_error Is thrown if the write fails
+ */
+void writeAll(int fd, struct iovec *parts, int count)
+{
+    while(count > 0)
+    {
+        ssize_t written = ::writev(fd, parts, count);
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+            throw std::runtime_error(std::string("Write failed: ") + std::strerror(errno));
+        }
+
+        size_t rest = static_cast<size_t>(written);
+        while(count > 0 && rest >= parts->iov_len)
+        {
+            rest -= parts->iov_len;
+            parts++;
+            count--;
+        }
+        if(count > 0)
+        {
+            parts->iov_base = static_cast<char*>(parts->iov_base) + rest;
+            parts->iov_len -= rest;
+        }
+    }
+}
+#endif
+
+} // namespace
+
+void vCardOutputSink::writeLarge(const char *data, size_t size)
+{
+    m_buffer->append(data, size);
+    flush();
+}
+
+// ===========================================================================
+
+vCardStreamSink::vCardStreamSink(std::ostream& os, size_t block_size):
+    vCardOutputSink(&m_own, block_size), m_os(&os)
+{
+}
+
+vCardStreamSink::~vCardStreamSink()
+{
+    flush();
+}
+
+void vCardStreamSink::flush()
+{
+    if(m_own.empty())
+        return;
+
+    m_os->write(m_own.data(), m_own.size());
+    m_own.clear();
+}
+
+void vCardStreamSink::writeLarge(const char *data, size_t size)
+{
+    flush();
+    m_os->write(data, size);
+}
+
+// ===========================================================================
+
+vCardFdSink::vCardFdSink(int fd, size_t block_size):
+    vCardOutputSink(&m_own, block_size), m_fd(fd)
+{
+}
+
+vCardFdSink::~vCardFdSink()
+{
+    try
+    {
+        flush();
+    }
+    catch(const std::runtime_error&)
+    {
+    }
+}
+
+void vCardFdSink::flush()
+{
+    if(m_own.empty())
+        return;
+
+    struct iovec part = {const_cast<char*>(m_own.data()), m_own.size()};
+    writeParts(&part, 1);
+}
+
+void vCardFdSink::writeLarge(const char *data, size_t size)
+{
+    struct iovec parts[2] = {{const_cast<char*>(m_own.data()), m_own.size()}, {const_cast<char*>(data), size}};
+    if(m_own.empty())
+        writeParts(parts + 1, 1);
+    else
+        writeParts(parts, 2);
+}
+
+void vCardFdSink::writeParts(struct iovec *parts, int count)
+{
+    try
+    {
+        writeAll(m_fd, parts, count);
+    }
+    catch(const std::runtime_error&)
+    {
+        // the output is lost anyway, the destructor should not try again
+        m_own.clear();
+        throw;
+    }
+    m_own.clear();
+}
+
+// ===========================================================================
+
+vCardCallbackSink::vCardCallbackSink(Callback callback, size_t block_size):
+    vCardOutputSink(&m_own, block_size), m_callback(std::move(callback))
+{
+}
+
+vCardCallbackSink::~vCardCallbackSink()
+{
+    try
+    {
+        flush();
+    }
+    catch(...)
+    {
+    }
+}
+
+void vCardCallbackSink::flush()
+{
+    if(m_own.empty())
+        return;
+
+    m_callback(m_own.data(), m_own.size());
+    m_own.clear();
+}
+
+void vCardCallbackSink::writeLarge(const char *data, size_t size)
+{
+    flush();
+    m_callback(data, size);
+}
@@ -0,0 +1,138 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "parallel_writer.h"
+
+namespace {
+
+// cards are formatted by chunks of this size
+const size_t VC_WRITE_CHUNK_CARDS = 256;
+
+// chunks formatted ahead of the written one, per thread
+const size_t VC_WRITE_WINDOW_PER_THREAD = 4;
+
+struct Slot {
+    std::string out;
+    bool done = false;
+    std::exception_ptr error;
+};
+
+} // namespace
+
+bool writeCardsParallel(size_t count, unsigned threads, vCardOutputSink& sink, const vCardChunkFormatter& format)
+{
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    size_t chunks = (count + VC_WRITE_CHUNK_CARDS - 1) / VC_WRITE_CHUNK_CARDS;
+    if(threads == 1 || chunks <= 1)
+        return false;
+
+    // chunk i is formatted in slot i % window, after chunk i - window is written
+    size_t window = std::min(chunks, threads * VC_WRITE_WINDOW_PER_THREAD);
+    std::vector<Slot> slots(window);
+    std::mutex mutex;
+    std::condition_variable ready, space;
+    size_t next = 0, written = 0;
+    bool stop = false;
+
+    auto worker = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for(;;)
+        {
+            space.wait(lock, [&]() { return stop || next >= chunks || next < written + window; });
+            if(stop || next >= chunks)
+                return;
+
+            size_t i = next++;
+            Slot& slot = slots[i % window];
+            lock.unlock();
+
+            std::exception_ptr error;
+            try
+            {
+                size_t begin = i * VC_WRITE_CHUNK_CARDS;
+                format(begin, std::min(count, begin + VC_WRITE_CHUNK_CARDS), slot.out);
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+            }
+
+            lock.lock();
+            slot.error = error;
+            slot.done = true;
+            ready.notify_one();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(unsigned t = 0; t < std::min<size_t>(threads, chunks); t++)
+        pool.emplace_back(worker);
+
+    // the calling thread stitches the chunks in order
+    std::exception_ptr error;
+    for(size_t i = 0; i < chunks && !error; i++)
+    {
+        Slot& slot = slots[i % window];
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready.wait(lock, [&slot]() { return slot.done; });
+        }
+
+        error = slot.error;
+        if(!error)
+        {
+            try
+            {
+                sink.write(slot.out.data(), slot.out.size());
+                sink.commit();
+            }
+            catch(...)
+            {
+                error = std::current_exception();
+            }
+        }
+
+        slot.out.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            slot.done = false;
+            written++;
+        }
+        space.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    space.notify_all();
+    for(std::thread& t : pool)
+        t.join();
+
+    if(error)
+        std::rethrow_exception(error);
+    return true;
+}
@@ -0,0 +1,41 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef VCARD_PARALLEL_WRITER_H
+#define VCARD_PARALLEL_WRITER_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include "output_sink.h"
+
+/**
+ * Appends the cards [begin, end) to `out`
+ */
+typedef std::function<void(size_t begin, size_t end, std::string& out)> vCardChunkFormatter;
+
+/**
+ * Formats `count` cards by chunks on `threads` threads (0 - number of cores) and passes the
+ * chunks to the sink in the order of the cards, as soon as all previous chunks are passed.
+ * Only a window of chunks is formatted ahead, so the memory does not depend on `count`.
+ * @return false if there is nothing to do in parallel (one thread or one chunk), nothing is
+ * written then and the caller writes the cards itself
+ * @throws Rethrows the first exception of the formatter or the sink, after the threads are stopped
+ */
+bool writeCardsParallel(size_t count, unsigned threads, vCardOutputSink& sink, const vCardChunkFormatter& format);
+
+#endif //VCARD_PARALLEL_WRITER_H
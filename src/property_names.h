@@ -0,0 +1,130 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef VCARD_PROPERTY_NAMES_H
+#define VCARD_PROPERTY_NAMES_H
+
+#include <cstddef>
+#include <cstdint>
+#include "string_ref.h"
+
+// Dispatch of the property names known to the parser: the name of the line is mapped to its
+// id by the perfect hash table built and checked at compile time.
+
+enum PropertyId {
+    VC_ID_UNKNOWN = 0,
+    VC_ID_BEGIN, VC_ID_END, VC_ID_VERSION, VC_ID_SOURCE, VC_ID_KIND, VC_ID_XML, VC_ID_FN, VC_ID_N,
+    VC_ID_NICKNAME, VC_ID_PHOTO, VC_ID_BDAY, VC_ID_ANNIVERSARY, VC_ID_GENDER, VC_ID_ADR, VC_ID_LABEL,
+    VC_ID_TEL, VC_ID_EMAIL, VC_ID_IMPP, VC_ID_LANG, VC_ID_TZ, VC_ID_GEO, VC_ID_TITLE, VC_ID_ROLE,
+    VC_ID_LOGO, VC_ID_ORG, VC_ID_MEMBER, VC_ID_RELATED, VC_ID_CATEGORIES, VC_ID_NOTE, VC_ID_PRODID,
+    VC_ID_REV, VC_ID_SOUND, VC_ID_UID, VC_ID_CLIENTPIDMAP, VC_ID_URL, VC_ID_KEY, VC_ID_FBURL,
+    VC_ID_CALADRURI, VC_ID_CALURI, VC_ID_AGENT, VC_ID_MAILER, VC_ID_NAME, VC_ID_PROFILE,
+    VC_ID_SORT_STRING, VC_ID_CLASS,
+    VC_ID_COUNT
+};
+
+namespace property_names {
+
+// names in the order of PropertyId, starting from VC_ID_BEGIN
+constexpr const char *names[] = {
+    "BEGIN", "END", "VERSION", "SOURCE", "KIND", "XML", "FN", "N",
+    "NICKNAME", "PHOTO", "BDAY", "ANNIVERSARY", "GENDER", "ADR", "LABEL",
+    "TEL", "EMAIL", "IMPP", "LANG", "TZ", "GEO", "TITLE", "ROLE",
+    "LOGO", "ORG", "MEMBER", "RELATED", "CATEGORIES", "NOTE", "PRODID",
+    "REV", "SOUND", "UID", "CLIENTPIDMAP", "URL", "KEY", "FBURL",
+    "CALADRURI", "CALURI", "AGENT", "MAILER", "NAME", "PROFILE",
+    "SORT-STRING", "CLASS"
+};
+
+const size_t SLOTS = 128;
+const size_t MAX_NAME = 12;
+
+static_assert(sizeof(names) / sizeof(names[0]) == VC_ID_COUNT - 1, "names do not match PropertyId");
+
+constexpr size_t length(const char *s)
+{
+    return *s ? 1 + length(s + 1) : 0;
+}
+
+constexpr unsigned upper(char c)
+{
+    return static_cast<unsigned char>((c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c);
+}
+
+constexpr size_t hash(const char *s, size_t size)
+{
+    return (size * 5 + upper(s[0]) * 23 + upper(s[size - 1]) * 12 + upper(s[size / 2])) & (SLOTS - 1);
+}
+
+struct Table {
+    uint8_t slots[SLOTS];   // PropertyId or VC_ID_UNKNOWN
+};
+
+constexpr Table buildTable()
+{
+    Table table {};
+    for(size_t i = 0; i < VC_ID_COUNT - 1; i++)
+        table.slots[hash(names[i], length(names[i]))] = static_cast<uint8_t>(i + 1);
+    return table;
+}
+
+constexpr bool isPerfect()
+{
+    Table table = buildTable();
+    for(size_t i = 0; i < VC_ID_COUNT - 1; i++)
+    {
+        if(table.slots[hash(names[i], length(names[i]))] != i + 1 || length(names[i]) > MAX_NAME)
+            return false;
+    }
+    return true;
+}
+
+static_assert(isPerfect(), "collision in the property names hash, change the hash function");
+
+constexpr Table table = buildTable();
+
+} // namespace property_names
+
+/**
+ * Returns id of the property name (case-insensitive), VC_ID_UNKNOWN for other names
+ */
+static inline PropertyId propertyId(vCardStringRef name)
+{
+    using namespace property_names;
+    if(name.empty() || name.size() > MAX_NAME)
+        return VC_ID_UNKNOWN;
+
+    unsigned id = table.slots[hash(name.data(), name.size())];
+    if(id == VC_ID_UNKNOWN || !name.equalsNoCase(names[id - 1]))
+        return VC_ID_UNKNOWN;
+    return static_cast<PropertyId>(id);
+}
+
+static inline bool isBinaryProperty(PropertyId id)
+{
+    return id == VC_ID_PHOTO || id == VC_ID_LOGO || id == VC_ID_SOUND || id == VC_ID_KEY;
+}
+
+/**
+ * X- extension property name
+ */
+static inline bool isExtensionName(vCardStringRef name)
+{
+    return name.size() > 2 && (name[0] == 'X' || name[0] == 'x') && name[1] == '-';
+}
+
+#endif //VCARD_PROPERTY_NAMES_H
@@ -0,0 +1,73 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VCARD_SIMD_H
+#define VCARD_SIMD_H
+
+// Helpers for vectorized code paths. SSE2 is the baseline on x86-64, wider instruction
+// sets are compiled with target attributes and selected at runtime, so the library
+// does not need special compiler flags and runs on any CPU.
+
+#include <cstdint>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VC_SIMD_X86
+#endif
+
+#if defined(VC_SIMD_X86) && defined(__SSE2__)
+#define VC_SIMD_SSE2
+#endif
+
+#if defined(VC_SIMD_X86) && defined(__GNUC__)
+#define VC_SIMD_AVX2
+#define VC_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+#ifdef VC_SIMD_AVX2
+static inline bool cpuHasAvx2()
+{
+    static const bool has_avx2 = __builtin_cpu_supports("avx2");
+    return has_avx2;
+}
+#endif
+
+/**
+ * Index of the lowest set bit of the mask, the mask must not be 0
+ */
+static inline unsigned countTrailingZeros(uint64_t mask)
+{
+#if defined(__GNUC__)
+    return static_cast<unsigned>(__builtin_ctzll(mask));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    unsigned n = 0;
+    for(; !(mask & 1); mask >>= 1)
+        n++;
+    return n;
+#endif
+}
+
+#endif //VCARD_SIMD_H
@@ -0,0 +1,178 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstring>
+#include "structural_index.h"
+#include "simd.h"
+
+namespace {
+
+/**
+ * Classifies 64 bytes of the line
+ * @return Bit mask of ':', ';', '.', '=', ',' characters, quotes mask is returned in `quotes`
+ */
+typedef uint64_t (*ClassifyFunc)(const char *block, uint64_t& quotes);
+
+#ifndef VC_SIMD_SSE2
+uint64_t classifyScalar(const char *block, uint64_t& quotes)
+{
+    uint64_t structural = 0;
+    quotes = 0;
+    for(int i = 0; i < 64; i++)
+    {
+        switch(block[i])
+        {
+            case ':': case ';': case '.': case '=': case ',':
+                structural |= uint64_t(1) << i;
+                break;
+            case '"':
+                quotes |= uint64_t(1) << i;
+                break;
+        }
+    }
+
+    return structural;
+}
+#endif
+
+#ifdef VC_SIMD_SSE2
+uint64_t classifySse2(const char *block, uint64_t& quotes)
+{
+    const __m128i colon = _mm_set1_epi8(':'), semicolon = _mm_set1_epi8(';'), point = _mm_set1_epi8('.');
+    const __m128i equal = _mm_set1_epi8('='), comma = _mm_set1_epi8(','), quote = _mm_set1_epi8('"');
+
+    uint64_t structural = 0;
+    quotes = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + i * 16));
+        __m128i s = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, colon), _mm_cmpeq_epi8(v, semicolon)),
+                                 _mm_or_si128(_mm_cmpeq_epi8(v, point), _mm_cmpeq_epi8(v, equal)));
+        s = _mm_or_si128(s, _mm_cmpeq_epi8(v, comma));
+        structural |= uint64_t(uint16_t(_mm_movemask_epi8(s))) << (i * 16);
+        quotes |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(v, quote)))) << (i * 16);
+    }
+
+    return structural;
+}
+#endif
+
+#ifdef VC_SIMD_AVX2
+VC_TARGET_AVX2 uint64_t classifyAvx2(const char *block, uint64_t& quotes)
+{
+    const __m256i colon = _mm256_set1_epi8(':'), semicolon = _mm256_set1_epi8(';'), point = _mm256_set1_epi8('.');
+    const __m256i equal = _mm256_set1_epi8('='), comma = _mm256_set1_epi8(','), quote = _mm256_set1_epi8('"');
+
+    uint64_t structural = 0;
+    quotes = 0;
+    for(int i = 0; i < 2; i++)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + i * 32));
+        __m256i s = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, colon), _mm256_cmpeq_epi8(v, semicolon)),
+                                    _mm256_or_si256(_mm256_cmpeq_epi8(v, point), _mm256_cmpeq_epi8(v, equal)));
+        s = _mm256_or_si256(s, _mm256_cmpeq_epi8(v, comma));
+        structural |= uint64_t(uint32_t(_mm256_movemask_epi8(s))) << (i * 32);
+        quotes |= uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, quote)))) << (i * 32);
+    }
+
+    return structural;
+}
+#endif
+
+ClassifyFunc selectClassify()
+{
+#ifdef VC_SIMD_AVX2
+    if(cpuHasAvx2())
+        return classifyAvx2;
+#endif
+#ifdef VC_SIMD_SSE2
+    return classifySse2;
+#else
+    return classifyScalar;
+#endif
+}
+
+const ClassifyFunc classify = selectClassify();
+
+/**
+ * Bit i of the result is xor of bits 0..i, for quotes mask it marks characters inside quotes
+ * (opening quote included, closing quote excluded)
+ */
+inline uint64_t prefixXor(uint64_t x)
+{
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+} // namespace
+
+void StructuralIndex::build(vCardStringRef line, bool stop_at_colon)
+{
+    m_positions.clear();
+    m_colon = vCardStringRef::npos;
+
+    uint64_t inside_carry = 0; // all ones if previous block ended inside quotes
+    for(size_t base = 0; base < line.size(); base += 64)
+    {
+        uint64_t structural, quotes;
+        if(line.size() - base >= 64)
+            structural = classify(line.data() + base, quotes);
+        else
+        {
+            // zero padded tail does not contain structural characters
+            char tail[64] = {0};
+            std::memcpy(tail, line.data() + base, line.size() - base);
+            structural = classify(tail, quotes);
+        }
+
+        uint64_t inside = prefixXor(quotes) ^ inside_carry;
+        inside_carry = static_cast<uint64_t>(static_cast<int64_t>(inside) >> 63);
+
+        uint64_t bits = (structural & ~inside) | quotes;
+
+        uint64_t colons = 0;
+        if(stop_at_colon)
+        {
+            for(uint64_t b = bits & ~quotes; b; b &= b - 1)
+            {
+                if(line[base + countTrailingZeros(b)] == ':')
+                {
+                    colons = b & -b;
+                    break;
+                }
+            }
+
+            if(colons)
+                bits &= (colons << 1) - 1;
+        }
+
+        for(; bits; bits &= bits - 1)
+            m_positions.push_back(static_cast<uint32_t>(base + countTrailingZeros(bits)));
+
+        if(colons)
+        {
+            m_colon = m_positions.back();
+            return;
+        }
+    }
+}
@@ -0,0 +1,52 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef VCARD_STRUCTURAL_INDEX_H
+#define VCARD_STRUCTURAL_INDEX_H
+
+#include <cstdint>
+#include <vector>
+#include "string_ref.h"
+
+/**
+ * @brief Positions of structural characters of the property line: ':', ';', '.', '=', ','
+ * outside of quoted strings and all '"'. Built in one pass by 64-byte blocks (vectorized
+ * when available), property and params parsers jump between positions instead of
+ * rescanning the line byte by byte.
+ */
+class StructuralIndex {
+public:
+    /**
+     * Indexes the line. If stop_at_colon is set indexing stops at the first unquoted ':'
+     * (it is the last position), so the property value is not scanned.
+     */
+    void build(vCardStringRef line, bool stop_at_colon);
+
+    const std::vector<uint32_t>& positions() const { return m_positions; }
+
+    /**
+     * Position of the first unquoted ':' or npos
+     */
+    size_t colon() const { return m_colon; }
+
+protected:
+    std::vector<uint32_t> m_positions;
+    size_t m_colon;
+};
+
+#endif //VCARD_STRUCTURAL_INDEX_H
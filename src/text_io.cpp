@@ -17,351 +17,1357 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+#include <thread>
 #include "text_io.h"
+#include "vcard_batch.h"
+#include "vcard_blob.h"
+#include "charset.h"
 #include "utils.h"
+#include "line_scanner.h"
+#include "property_names.h"
+#include "structural_index.h"
+#include "utf16.h"
+#include "parallel_writer.h"
 
-std::istream *safeGetline(std::istream *is, std::string &t)
-{
-    t.clear();
+namespace {
 
-    // The characters in the stream are read one-by-one using a std::streambuf.
-    // That is faster than reading them one-by-one using the std::istream.
-    // Code that uses streambuf this way must be guarded by a sentry object.
-    // The sentry object performs various tasks,
-    // such as thread synchronization and updating the stream state.
+// stream is read by blocks of this size
+const size_t VC_READ_BLOCK = 64 * 1024;
 
-    std::istream::sentry se(*is, true);
-    std::streambuf *sb = is->rdbuf();
+// minimal free space of the buffer for reading, enough for any converted UTF-16 character
+const size_t VC_MIN_READ = 16;
 
-    for(;;)
+// parsed part of the mapped file is released by blocks of this size
+const size_t VC_RELEASE_WINDOW = 32 * 1024 * 1024;
+
+// buffer is split into (threads * VC_CHUNKS_PER_THREAD) chunks to balance the load
+const size_t VC_CHUNKS_PER_THREAD = 4;
+const size_t VC_MIN_CHUNK_SIZE = 64 * 1024;
+
+// inline values of binary properties starting from this size are kept as lazy blobs
+const size_t VC_MIN_BLOB_SIZE = 1024;
+
+// output is written to the stream by blocks of this size
+const size_t VC_WRITE_BLOCK = 64 * 1024;
+
+// maximal length of the output line without CRLF
+const size_t VC_FOLD_LENGTH = 75;
+
+/**
+ * Finds the beginning of the first line after "END:VCARD" line, starting search from `from`.
+ * The reader is always outside of a card after END line, so the buffer can be split there.
+ * Folded lines are respected: "END:VCARD" is a boundary only when it is a whole unfolded line.
+ */
+const char *findCardBoundary(const char *from, const char *begin, const char *end)
+{
+    static const char token[] = VC_END_TOKEN;
+    const size_t token_size = sizeof(token) - 1;
+
+    const char *p = from;
+    while((p = std::search(p, end, token, token + token_size)) != end)
     {
-        int c = sb->sbumpc();
-        switch(c)
-        {
-            case '\n':
-                return is;
-            case '\r':
-                if(sb->sgetc() == '\n')
-                {
-                    sb->sbumpc();
-                    // special case for vCard folding lines
-                    if(sb->sgetc() == ' ' || sb->sgetc() == '\t' || sb->sgetc() == '=' || sb->sgetc() == ';')
-                    {
-                        sb->sbumpc();
-                        continue;
-                    }
-                }
+        const char *line_end = p + token_size;
+        bool line_start = p == begin || p[-1] == '\n' || p[-1] == '\r';
+        p++;
+        if(!line_start)
+            continue;
 
-                return is;
-            case std::streambuf::traits_type::eof():
-                // Also handle the case when the last line has no line ending
-                if(t.empty())
-                    is->setstate(std::ios::eofbit);
-                return is;
-            default:
-                t += (char) c;
-        }
+        if(line_end == end)
+            return end;
+
+        if(*line_end == '\n')
+            return line_end + 1;
+
+        if(*line_end != '\r')
+            continue;
+
+        if(line_end + 1 == end || line_end[1] != '\n')
+            return line_end + 1;
+
+        line_end += 2;
+        if(line_end == end || !isFoldingChar(*line_end))
+            return line_end;
     }
+
+    return end;
 }
 
-vCardParamMap TextReader::parseParams(std::string input)
+/**
+ * Builds vCard object
+ */
+class CardBuilder : public vCardBuilder {
+public:
+    explicit CardBuilder(vCard& card): m_card(card) {}
+
+    void beginCard() override { m_card.clear(); }
+    void setVersion(vCardVersion version) override { m_card.setVersion(version); }
+    void addProperty(const vCardPropertyRef& prop) override { m_card.addProperty(prop.toProperty()); }
+    void endCard() override {}
+
+protected:
+    vCard& m_card;
+};
+
+StructuralIndex& lineIndex()
 {
-    vCardParamMap params;
-    int i = 0, start_pos = 0;
-    while(i < input.size())
+    static thread_local StructuralIndex index;
+    return index;
+}
+
+/**
+ * Parses params in [begin, end) of the line using structural index of the line
+ */
+vCardParseError parseIndexedParams(vCardStringRef line, const std::vector<uint32_t>& positions,
+                                   size_t begin, size_t end, std::vector<vCardParamRef>& params)
+{
+    params.clear();
+
+    auto k = std::lower_bound(positions.begin(), positions.end(), begin);
+    // returns position of the next structural character `a` or `b` at or after `from`, or end
+    auto seek = [&](size_t from, char a, char b) -> size_t {
+        while(k != positions.end() && *k < from)
+            k++;
+        while(k != positions.end() && *k < end && line[*k] != a && line[*k] != b)
+            k++;
+        return (k != positions.end() && *k < end) ? *k : end;
+    };
+
+    size_t i = begin;
+    while(i < end)
     {
         // get params name
-        while(input[i] != '=' && i < input.size())
+        size_t start_pos = i;
+        i = seek(i, VC_TYPE_SEP_TOKEN, VC_SEPARATOR_TOKEN);
+
+        if(i == end || line[i] == VC_SEPARATOR_TOKEN)
+        {
+            // vCard 2.1 style parameter without name, e.g. "TEL;CELL;HOME:..."
+            if(i > start_pos)
+                params.push_back(vCardParamRef("TYPE", line.substr(start_pos, i - start_pos)));
             i++;
+            continue;
+        }
 
-        std::string name = input.substr(start_pos, i - start_pos);
+        vCardStringRef name = line.substr(start_pos, i - start_pos);
+        // TYPE and SORT-AS special cases, see https://www.rfc-editor.org/errata/eid3488
+        bool split_quoted = name.equalsNoCase("TYPE") || name.equalsNoCase("SORT-AS");
         i++; // skip '='
-        start_pos = i;
 
         // get params values
         while(true)
         {
-            while(i < input.size() && input[i] != ';' && input[i] != ',')
-            {
-                if(input[i] == '\"')
-                {        // read everything inside ""
-                    i++; // skip first '"'
-                    start_pos = i;
-                    while(input[i] != '\"' && i < input.size())
-                        i++;
+            vCardStringRef value;
+            if(i < end && line[i] == '\"')
+            {   // read everything inside "", nothing inside is indexed, so the next position is closing quote
+                size_t closing = seek(i + 1, '\"', '\"');
+                if(closing == end)
+                    return VC_PARSE_UNCLOSED_QUOTE;
 
-                    if(i >= input.size())
-                        throw std::runtime_error("Parsing error: not closed DQUOTE");
-
-                    break;
-                }
-                else
-                {
-                    i++;
-                }
+                value = line.substr(i + 1, closing - i - 1);
+                i = seek(closing + 1, VC_SEPARATOR_TOKEN, ',');
+            }
+            else
+            {
+                start_pos = i;
+                i = seek(i, VC_SEPARATOR_TOKEN, ',');
+                value = line.substr(start_pos, i - start_pos);
             }
 
-            std::string value = input.substr(start_pos, i - start_pos);
-
-            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::toupper(c); });
-            if(name == "TYPE" || name == "SORT-AS")
+            if(split_quoted)
             {
-                std::vector<std::string> p = split(value, ',');
-                for(auto &s : p)
-                    params.addParam(name, s);
+                size_t from = 0, comma;
+                while((comma = value.find(',', from)) != vCardStringRef::npos)
+                {
+                    params.push_back(vCardParamRef(name, value.substr(from, comma - from)));
+                    from = comma + 1;
+                }
+                params.push_back(vCardParamRef(name, value.substr(from)));
             }
             else
-                params.addParam(name, value);
+                params.push_back(vCardParamRef(name, value));
 
-            if(input[i] == '\"')
-                i++; // skip last '"'
-            i++;     // skip ';' or ','
-            start_pos = i;
-
-            if(input[i - 1] == ';' || i >= input.size())
+            if(i >= end || line[i++] == VC_SEPARATOR_TOKEN || i >= end)
                 break;
         }
     }
 
-    return params;
+    return VC_PARSE_OK;
 }
 
-vCardProperty TextReader::parseProperty(std::string line)
+/**
+ * Searches the end of the logical line (not followed by fold) starting from `p`.
+ * @return false if more input is needed, `p` is set to the position to resume the search from
+ */
+bool findLogicalLineEnd(const char *&p, const char *end)
 {
-    // find first nonquoted ':', first ';' and first '.'
-    int i = 0, colon_pos = -1, first_semicln_pos = -1, first_point_pos = -1;
-    bool quoted = false;
-    while(i < line.size())
+    for(;;)
     {
-        if(line[i] == VC_ASSIGNMENT_TOKEN && !quoted)
-            break;
+        const char *e = findLineEnd(p, end);
+        if(e == end)
+        {
+            p = end;
+            return false;
+        }
+
+        // the same rules as in splitLine(): only CRLF may be followed by fold
+        if(*e == '\n')
+            return true;
+        if(e + 1 == end || (e[1] == '\n' && e + 2 == end))
+        {
+            p = e;
+            return false;
+        }
+        if(e[1] != '\n' || !isFoldingChar(e[2]))
+            return true;
 
-        if(line[i] == ';' && first_semicln_pos < 0) // first ';' could not be quoted
-            first_semicln_pos = i;
+        p = e + 3;
+    }
+}
 
-        if(line[i] == '.' && first_point_pos < 0)
-            first_point_pos = i;
+/**
+ * Checks if [p, end) is "END:VCARD" line ending with CR or CRLF
+ */
+bool isEndLine(const char *p, const char *end)
+{
+    static const char token[] = VC_END_TOKEN;
+    const size_t token_size = sizeof(token) - 1;
+    size_t size = end - p;
+    return (size == token_size + 1 || size == token_size + 2) && std::memcmp(p, token, token_size) == 0
+            && p[token_size] == '\r' && (size == token_size + 1 || p[token_size + 1] == '\n');
+}
 
-        if(line[i] == '\"')
-            quoted = !quoted;
+/**
+ * Returns the name of the property line (without group), the line is not validated
+ */
+vCardStringRef propertyName(vCardStringRef line)
+{
+    size_t begin = 0;
+    for(size_t i = 0; i < line.size(); i++)
+    {
+        char c = line[i];
+        if(c == VC_SEPARATOR_TOKEN || c == VC_ASSIGNMENT_TOKEN)
+            return line.substr(begin, i - begin);
+        // the same as TextReader::parseProperty: only the first '.' ends the group
+        if(c == '.' && begin == 0 && i > 0)
+            begin = i + 1;
+    }
+    return line.substr(begin);
+}
 
-        i++;
+/**
+ * Counts line ends (CRLF, LF or CR) in [p, end)
+ */
+size_t countLines(const char *p, const char *end)
+{
+    size_t count = 0;
+    while((p = findLineEnd(p, end)) != end)
+    {
+        if(*p == '\r' && p + 1 != end && p[1] == '\n')
+            p++;
+        p++;
+        count++;
     }
+    return count;
+}
 
-    colon_pos = i;
-    if(colon_pos == line.size())
-        throw std::runtime_error("Error parsing property, no ':' found");
+/**
+ * ENCODING=QUOTED-PRINTABLE or vCard 2.1 style parameter without name
+ */
+bool isQuotedPrintable(const vCardParamRef& param)
+{
+    return (param.getName().equalsNoCase("ENCODING") || param.getName().equalsNoCase("TYPE"))
+            && param.getValue().equalsNoCase("QUOTED-PRINTABLE");
+}
 
-    std::string group, name;
-    vCardParamMap params;
-    if(first_semicln_pos > 0 && first_semicln_pos < colon_pos)
-    { // we have parameters in property
-        if(first_point_pos > 0 && first_point_pos < first_semicln_pos)
+bool isQuotedPrintable(const std::vector<vCardParamRef>& params)
+{
+    for(const vCardParamRef& p : params)
+        if(isQuotedPrintable(p))
+            return true;
+    return false;
+}
+
+vCardProperty createProperty(vCardStringRef group, vCardStringRef name, std::string value,
+                             const vCardParamRef *params, size_t params_count,
+                             bool skip_encoding, bool skip_charset)
+{
+    vCardProperty prop(group.str(), name.str(), std::move(value));
+
+    if(params_count > 0)
+    {
+        vCardParamMap map;
+        for(size_t i = 0; i < params_count; i++)
         {
-            group = line.substr(0, first_point_pos);
-            name = line.substr(first_point_pos + 1, first_semicln_pos - first_point_pos - 1);
+            if((skip_encoding && isQuotedPrintable(params[i]))
+                    || (skip_charset && params[i].getName().equalsNoCase("CHARSET")))
+                continue;
+            map.addParam(params[i].getName(), params[i].getValue().str());
         }
-        else
+        prop.setParams(map);
+    }
+
+    return prop;
+}
+
+} // namespace
+
+//============================================================================
+
+const char *vCardDiagnostic::reason() const
+{
+    switch(error)
+    {
+    case VC_PARSE_OK:
+        return "No error";
+    case VC_PARSE_NO_COLON:
+        return "Error parsing property, no ':' found";
+    case VC_PARSE_UNCLOSED_QUOTE:
+        return "Parsing error: not closed DQUOTE";
+    case VC_PARSE_OUTSIDE_CARD:
+        return "Line outside of the card";
+    case VC_PARSE_UNEXPECTED_END:
+        return "Input ended inside of the card";
+    }
+    return "Unknown error";
+}
+
+//============================================================================
+
+bool vCardAssembler::feed(vCardStringRef line, vCardStringRef source, vCardBuilder& builder)
+{
+    if(m_softBreak)
+    {
+        m_softBreak = false;
+        vCardStringRef joined_name = propertyName(vCardStringRef(m_joined));
+        if(line != VC_END_TOKEN)
         {
-            name = line.substr(0, first_semicln_pos);
+            m_joined.append(line.data(), line.size());
+            addProperty(vCardStringRef(m_joined), joined_name, vCardStringRef(), builder);
+            return false;
         }
 
-        if(name != VC_VERSION)
+        // the last value of the card ends with '='
+        addProperty(vCardStringRef(m_joined), joined_name, vCardStringRef(), builder, false);
+    }
+
+    // the name is extracted once and dispatched by the table of known names,
+    // so values containing e.g. "VERSION" are not mistaken
+    vCardStringRef name = propertyName(line);
+    PropertyId id = propertyId(name);
+    if(!m_started)
+    {
+        if(id == VC_ID_BEGIN && line == VC_BEGIN_TOKEN)
         {
-            std::string params_string = line.substr(first_semicln_pos + 1, colon_pos - first_semicln_pos - 1);
-            // Issue: Fix error on CELL or other single type.
-            if(params_string.find("=") == std::string::npos)
-            {
-                constexpr auto TYPE_STR = "TYPE=";
-                std::string validate {};
-                i = 0;
-                first_semicln_pos = 0;
-                params_string+=';';
-                while(i < params_string.length())
-                {
-                    if(params_string[i] == ';')
-                    {
-                        validate += TYPE_STR;
-                        validate += params_string.substr(first_semicln_pos, i - first_semicln_pos);
-                        first_semicln_pos=i+1;
-                        validate += ';'; // Next
-                    }
-                    ++i;
-                }
+            m_started = true;
+            m_cardLine = m_line;
+            m_cardOffset = m_offset;
+            builder.beginCard();
+        }
+        else if(!line.empty())
+        {
+            report(VC_PARSE_OUTSIDE_CARD, m_line, m_offset);
+        }
+        return false;
+    }
 
-                params_string = validate;
-            }
+    switch(id)
+    {
+    case VC_ID_END:
+        if(line != VC_END_TOKEN)
+            break;
+        m_started = false;
+        builder.endCard();
+        return true;
 
-            params = TextReader::parseParams(params_string);
+    case VC_ID_VERSION:
+    {
+        size_t pos = line.find(VC_ASSIGNMENT_TOKEN);
+        if(pos != vCardStringRef::npos)
+        {
+            vCardStringRef version = line.substr(pos + 1).trimmed();
+            if(version == "3.0")
+                builder.setVersion(VC_VER_3_0);
+            if(version == "2.1")
+                builder.setVersion(VC_VER_2_1);
         }
+        return false;
+    }
+
+    default:
+        break;
+    }
+
+    addProperty(line, name, source, builder);
+    return false;
+}
+
+void vCardAssembler::setExtensionHandler(const std::string& name, vCardExtensionHandler *handler)
+{
+    if(!isExtensionName(name))
+        throw std::runtime_error("Not an extension property name: " + name);
+
+    auto it = std::find_if(m_extensions.begin(), m_extensions.end(),
+                           [&name](const ExtensionHandlers::value_type& e) { return vCardStringRef(e.first).equalsNoCase(name); });
+    if(it == m_extensions.end())
+    {
+        if(handler)
+            m_extensions.push_back(std::make_pair(name, handler));
     }
+    else if(handler)
+        it->second = handler;
     else
-    { // we do not have parameters
-        if(first_point_pos > 0 && first_point_pos < colon_pos)
+        m_extensions.erase(it);
+}
+
+void vCardAssembler::finish()
+{
+    m_softBreak = false;
+    if(m_started)
+    {
+        m_started = false;
+        report(VC_PARSE_UNEXPECTED_END, m_cardLine, m_cardOffset);
+    }
+}
+
+void vCardAssembler::report(vCardParseError error, size_t line, size_t offset)
+{
+    if(!m_sink)
+        return;
+
+    vCardDiagnostic diagnostic;
+    diagnostic.line = line;
+    diagnostic.offset = offset;
+    diagnostic.error = error;
+    m_sink->report(diagnostic);
+}
+
+void vCardAssembler::addProperty(vCardStringRef line, vCardStringRef name, vCardStringRef source, vCardBuilder& builder,
+                                 bool soft_break)
+{
+    if(line.empty())
+    {
+        return;
+    }
+
+    // projection: not requested lines are dropped by the name, only the line ending with '='
+    // is parsed to see if it is quoted-printable value continued on the next line
+    bool skip = false;
+    if(!m_projection.empty())
+    {
+        skip = std::none_of(m_projection.begin(), m_projection.end(),
+                            [name](const std::string& n) { return name.equalsNoCase(n); });
+        if(skip && (!soft_break || line[line.size() - 1] != '='))
+            return;
+    }
+
+    vCardParseError error = TextReader::tryParseProperty(line, m_prop);
+    if(error != VC_PARSE_OK)
+    {
+        report(error, m_line, m_offset);
+        return;
+    }
+
+    vCardStringRef value = m_prop.m_value;
+    if(soft_break && !value.empty() && value[value.size() - 1] == '=' && isQuotedPrintable(m_prop.params()))
+    {
+        // the value continues on the next line, the line may be the joined one already
+        if(line.data() != m_joined.data())
+            m_joined.assign(line.data(), line.size());
+        m_joined.pop_back();
+        m_softBreak = true;
+        return;
+    }
+
+    if(skip)
+        return;
+
+    if(!m_extensions.empty() && isExtensionName(name))
+    {
+        for(const ExtensionHandlers::value_type& e : m_extensions)
         {
-            group = line.substr(0, first_point_pos);
-            name = line.substr(first_point_pos + 1, colon_pos - first_point_pos);
+            if(name.equalsNoCase(e.first))
+            {
+                if(!e.second->onExtension(m_prop))
+                    return;
+                break;
+            }
         }
-        else
+    }
+
+    if(value.size() >= VC_MIN_BLOB_SIZE && isBinaryProperty(propertyId(m_prop.m_name)))
+    {
+        m_prop.m_blob = true;
+        if(m_prop.m_owner)
+            m_prop.m_source = source;
+    }
+
+    builder.addProperty(m_prop);
+}
+
+//============================================================================
+
+void vCardHandler::addProperty(const vCardPropertyRef& prop)
+{
+    prop.getValue().split(VC_SEPARATOR_TOKEN, true, m_values);
+    onProperty(prop.getGroup(), prop.getName(), prop.params(), m_values);
+}
+
+//============================================================================
+
+std::vector<vCardStringRef> vCardPropertyRef::values() const
+{
+    return m_value.split(VC_SEPARATOR_TOKEN, true);
+}
+
+void vCardPropertyRef::clear()
+{
+    m_group = vCardStringRef();
+    m_name = vCardStringRef();
+    m_value = vCardStringRef();
+    m_params.clear();
+    m_blob = false;
+    m_source = vCardStringRef();
+}
+
+vCardProperty vCardPropertyRef::toProperty() const
+{
+    if(!m_blob)
+        return makeProperty(m_group, m_name, m_value, m_params.data(), m_params.size());
+
+    vCardProperty prop = makeProperty(m_group, m_name, vCardStringRef(), m_params.data(), m_params.size());
+    prop.setBlob(makeBlob());
+    return prop;
+}
+
+std::shared_ptr<const vCardBlob> vCardPropertyRef::makeBlob() const
+{
+    bool base64 = false;
+    for(const vCardParamRef& p : m_params)
+        if(p.getName().equalsNoCase("ENCODING") && vCardBlob::isBase64Encoding(p.getValue()))
+            base64 = true;
+
+    const char *begin = m_group.empty() ? m_name.data() : m_group.data();
+    size_t value_offset = m_value.data() - begin;
+    if(m_owner && !m_source.empty())
+        return std::make_shared<const vCardBlob>(m_owner, m_source, foldedOffset(m_source, value_offset), base64);
+
+    // transient source, the unfolded line is copied
+    return vCardBlob::copy(vCardStringRef(begin, m_value.end() - begin), value_offset, base64);
+}
+
+vCardProperty vCardPropertyRef::makeProperty(vCardStringRef group, vCardStringRef name, vCardStringRef value,
+                                             const vCardParamRef *params, size_t params_count)
+{
+    bool quoted_printable = false;
+    const Charset *charset = nullptr;
+    for(size_t i = 0; i < params_count; i++)
+    {
+        if(isQuotedPrintable(params[i]))
+            quoted_printable = true;
+        else if(params[i].getName().equalsNoCase("CHARSET"))
+            charset = Charset::find(params[i].getValue());
+    }
+
+    if(!quoted_printable && !charset)
+        return createProperty(group, name, value.str(), params, params_count, false, false);
+
+    std::string decoded;
+    if(quoted_printable)
+    {
+        decodeQuotedPrintable(value, decoded);
+        value = decoded;
+    }
+
+    if(charset && !charset->isUtf8())
+    {
+        std::string utf8;
+        charset->toUtf8(value, utf8);
+        decoded.swap(utf8);
+    }
+    else if(!quoted_printable)
+    {
+        decoded = value.str();
+    }
+
+    // the value is plain UTF-8 now, the encoding params do not describe it anymore
+    return createProperty(group, name, std::move(decoded), params, params_count, quoted_printable, charset != nullptr);
+}
+
+//============================================================================
+
+vCardParamMap TextReader::parseParams(std::string input)
+{
+    std::vector<vCardParamRef> refs;
+    TextReader::parseParams(vCardStringRef(input), refs);
+
+    vCardParamMap params;
+    for(const vCardParamRef& p : refs)
+        params.addParam(p.getName(), p.getValue().str());
+
+    return params;
+}
+
+vCardProperty TextReader::parseProperty(std::string line)
+{
+    vCardPropertyRef prop;
+    TextReader::parseProperty(vCardStringRef(line), prop);
+    return prop.toProperty();
+}
+
+void TextReader::parseParams(vCardStringRef input, std::vector<vCardParamRef>& params)
+{
+    vCardDiagnostic diagnostic;
+    diagnostic.error = tryParseParams(input, params);
+    if(diagnostic.error != VC_PARSE_OK)
+        throw std::runtime_error(diagnostic.reason());
+}
+
+void TextReader::parseProperty(vCardStringRef line, vCardPropertyRef& prop)
+{
+    vCardDiagnostic diagnostic;
+    diagnostic.error = tryParseProperty(line, prop);
+    if(diagnostic.error != VC_PARSE_OK)
+        throw std::runtime_error(diagnostic.reason());
+}
+
+vCardParseError TextReader::tryParseParams(vCardStringRef input, std::vector<vCardParamRef>& params)
+{
+    StructuralIndex& index = lineIndex();
+    index.build(input, false);
+    return parseIndexedParams(input, index.positions(), 0, input.size(), params);
+}
+
+vCardParseError TextReader::tryParseProperty(vCardStringRef line, vCardPropertyRef& prop)
+{
+    prop.clear();
+
+    // one pass over the line finds all structural characters before the first nonquoted ':'
+    StructuralIndex& index = lineIndex();
+    index.build(line, true);
+
+    size_t colon_pos = index.colon();
+    if(colon_pos == vCardStringRef::npos)
+        return VC_PARSE_NO_COLON;
+
+    // find first ';' and first '.' before params
+    size_t first_semicln_pos = vCardStringRef::npos, first_point_pos = vCardStringRef::npos;
+    for(uint32_t pos : index.positions())
+    {
+        if(line[pos] == VC_SEPARATOR_TOKEN)
         {
-            name = line.substr(0, colon_pos);
+            first_semicln_pos = pos;
+            break;
         }
+
+        if(line[pos] == '.' && first_point_pos == vCardStringRef::npos)
+            first_point_pos = pos;
     }
 
-    std::string value = line.substr(colon_pos + 1);
-    vCardProperty prop(group, name, value);
-    prop.setParams(params);
-    return prop;
+    size_t name_end = (first_semicln_pos == vCardStringRef::npos) ? colon_pos : first_semicln_pos;
+    if(first_point_pos != vCardStringRef::npos && first_point_pos > 0)
+    {
+        prop.m_group = line.substr(0, first_point_pos);
+        prop.m_name = line.substr(first_point_pos + 1, name_end - first_point_pos - 1);
+    }
+    else
+    {
+        prop.m_name = line.substr(0, name_end);
+    }
+
+    if(first_semicln_pos != vCardStringRef::npos && prop.m_name != VC_VERSION)
+    {
+        vCardParseError error = parseIndexedParams(line, index.positions(), first_semicln_pos + 1, colon_pos, prop.m_params);
+        if(error != VC_PARSE_OK)
+            return error;
+    }
+
+    prop.m_value = line.substr(colon_pos + 1);
+    return VC_PARSE_OK;
 }
 
 std::vector<vCard> TextReader::parseCards()
 {
     std::vector<vCard> vcards;
-    vCard current;
-    bool started = false;
-    bool trySkipContent = false;
-    std::string line;
-    while(!safeGetline(m_is, line)->eof())
+    *this >> vcards;
+    return vcards;
+}
+
+std::vector<vCard> TextReader::parseCards(unsigned threads)
+{
+    // already buffered data and the rest of the stream (converted to UTF-8)
+    while(!m_eof)
+        fillBuffer();
+
+    std::string buffer;
+    buffer.swap(m_buffer);
+    buffer.resize(m_tail);
+    buffer.erase(0, m_head);
+    m_head = m_tail = 0;
+
+    m_fail = true;
+    TextBufferReader reader(buffer);
+    reader.m_lineNumber = m_lineNumber;
+    reader.m_baseOffset = m_consumed;
+    reader.setDiagnostics(m_assembler.diagnostics());
+    reader.setProjection(m_assembler.projection());
+    reader.m_assembler.setExtensionHandlers(m_assembler.extensionHandlers());
+    return reader.parseCards(threads);
+}
+
+bool TextReader::readLine(vCardStringRef &line)
+{
+    for(;;)
     {
-        if((line == VC_BEGIN_TOKEN) && !started)
-        {
-            started = true;
-        }
-        else if((line == VC_END_TOKEN) && started)
+        if(m_head != m_tail)
         {
-            vcards.push_back(current);
-            trySkipContent = false;
-            started = false;
-            // Empty the current card
-            current = vCard();
-        }
-        else if((line.find("VERSION") != std::string::npos) && started)
-        {
-            size_t pos = line.find(":");
-            if(pos != std::string::npos)
+            const char *start = m_buffer.data() + m_head;
+            const char *next = splitLine(start, m_buffer.data() + m_tail, m_eof, line, m_unfolded);
+            if(next)
             {
-                std::string version = line.substr(pos + 1);
-                trim(version);
-                if(version == "3.0")
-                    current.setVersion(VC_VER_3_0);
-                if(version == "2.1")
-                    current.setVersion(VC_VER_2_1);
+                m_assembler.setPosition(m_lineNumber, m_consumed + m_head);
+                m_lineNumber += (line.data() == m_unfolded.data()) ? countLines(start, next) : 1;
+                m_head = next - m_buffer.data();
+                return true;
             }
-
-            continue;
         }
-        else if(started)
+        else if(m_eof)
+            return false;
+
+        fillBuffer();
+    }
+}
+
+void TextReader::fillBuffer()
+{
+    // The stream is read by big blocks directly from std::streambuf,
+    // lines are split in the buffer by vectorized scanner.
+    if(m_head > 0)
+    {
+        std::memmove(&m_buffer[0], &m_buffer[m_head], m_tail - m_head);
+        m_tail -= m_head;
+        m_consumed += m_head;
+        m_head = 0;
+    }
+
+    // the line is longer than the buffer
+    if(m_buffer.size() - m_tail < VC_MIN_READ)
+        m_buffer.resize(std::max(VC_READ_BLOCK, m_buffer.size() * 2));
+
+    size_t n = readInput(&m_buffer[m_tail], m_buffer.size() - m_tail);
+    if(n > 0)
+        m_tail += n;
+    else
+    {
+        m_eof = true;
+        m_is->setstate(std::ios::eofbit);
+    }
+}
+
+size_t TextReader::readInput(char *dst, size_t capacity)
+{
+    std::streambuf *buf = m_is->rdbuf();
+    if(!m_detected)
+    {
+        m_detected = true;
+        char head[3];
+        size_t size = static_cast<size_t>(std::max<std::streamsize>(0, buf->sgetn(head, sizeof(head))));
+        size_t bom_size;
+        TextEncoding encoding = detectEncoding(head, size, m_code, bom_size);
+        m_utf16 = encoding != VC_TEXT_UTF8;
+        m_bigEndian = encoding == VC_TEXT_UTF16BE;
+        m_raw.assign(head + bom_size, size - bom_size);
+    }
+
+    if(!m_utf16)
+    {
+        // bytes read by the detection go first
+        size_t n = m_raw.size();
+        std::memcpy(dst, m_raw.data(), n);
+        m_raw.clear();
+        std::streamsize r = buf->sgetn(dst + n, capacity - n);
+        return n + static_cast<size_t>(std::max<std::streamsize>(0, r));
+    }
+
+    // UTF-16 is read into m_raw, incomplete character at the end waits for the next block
+    size_t raw_capacity = (capacity - 3) / 3 * 2;
+    for(;;)
+    {
+        size_t rest = m_raw.size();
+        m_raw.resize(raw_capacity);
+        std::streamsize r = buf->sgetn(&m_raw[rest], raw_capacity - rest);
+        bool final = r <= 0;
+        size_t size = rest + (final ? 0 : static_cast<size_t>(r));
+
+        size_t consumed;
+        size_t n = utf16ToUtf8(m_raw.data(), size, m_bigEndian, final, dst, consumed);
+        m_raw.resize(size);
+        m_raw.erase(0, consumed);
+        if(n > 0 || final)
+            return n;
+    }
+}
+
+bool TextReader::readCard(vCard &card)
+{
+    card.clear();
+    CardBuilder builder(card);
+    vCardStringRef line;
+    while(readLine(line))
+    {
+        if(m_assembler.feed(line, builder))
+            return true;
+    }
+
+    m_assembler.finish();
+    return false;
+}
+
+size_t TextReader::readBatch(vCardBatch &batch, size_t max_cards)
+{
+    size_t count = 0;
+    vCardStringRef line;
+    while((max_cards == 0 || count < max_cards) && readLine(line))
+    {
+        if(m_assembler.feed(line, batch))
+            count++;
+    }
+
+    if(m_eof && m_head == m_tail)
+        m_assembler.finish();
+    return count;
+}
+
+size_t TextReader::parse(vCardBuilder& builder)
+{
+    size_t count = 0;
+    vCardStringRef line;
+    while(readLine(line))
+    {
+        if(m_assembler.feed(line, builder))
+            count++;
+    }
+
+    m_assembler.finish();
+    return count;
+}
+
+TextReader &TextReader::operator>>(vCard &vCard)
+{
+    m_fail = !readCard(vCard);
+    return *this;
+}
+
+TextReader &TextReader::operator>>(std::vector<vCard> &cards)
+{
+    vCard current;
+    while(readCard(current))
+        cards.push_back(std::move(current));
+
+    m_fail = true;
+    return *this;
+}
+
+//============================================================================
+
+TextBufferReader::TextBufferReader(const char *data, size_t size, vCardEncoding code):
+    m_begin(data), m_end(data + size), m_pos(data), m_line(data), m_lineNumber(1), m_baseOffset(0), m_released(0)
+{
+    size_t bom_size;
+    TextEncoding encoding = detectEncoding(data, size, code, bom_size);
+    if(encoding == VC_TEXT_UTF8)
+    {
+        m_pos = m_line = data + bom_size;
+        return;
+    }
+
+    // the converted text is owned by the reader and shared with binary properties
+    std::shared_ptr<const std::string> text = std::make_shared<const std::string>(
+        utf16ToUtf8(data + bom_size, size - bom_size, encoding == VC_TEXT_UTF16BE));
+    m_begin = m_pos = m_line = text->data();
+    m_end = m_begin + text->size();
+    m_owner = text;
+    m_assembler.setOwner(m_owner);
+}
+
+TextBufferReader::TextBufferReader(const std::string& buffer, vCardEncoding code):
+    TextBufferReader(buffer.data(), buffer.size(), code)
+{
+}
+
+TextBufferReader::TextBufferReader(std::shared_ptr<const vCardMappedFile> file, vCardEncoding code):
+    TextBufferReader(file->data(), file->size(), code)
+{
+    if(m_owner)
+        return;     // UTF-16 file is converted already
+
+    m_file = file;
+    m_owner = file;
+    m_assembler.setOwner(m_owner);
+}
+
+TextBufferReader::TextBufferReader(std::shared_ptr<const std::string> buffer, vCardEncoding code):
+    TextBufferReader(buffer->data(), buffer->size(), code)
+{
+    if(m_owner)
+        return;
+
+    m_owner = buffer;
+    m_assembler.setOwner(m_owner);
+}
+
+bool TextBufferReader::readLine(vCardStringRef& line)
+{
+    if(m_pos == m_end)
+        return false;
+
+    size_t offset = m_pos - m_begin;
+    if(m_file && offset - m_released >= VC_RELEASE_WINDOW)
+    {
+        m_file->release(m_released, offset - m_released);
+        m_released = offset;
+    }
+
+    m_line = m_pos;
+    m_pos = splitLine(m_pos, m_end, true, line, m_unfolded);
+    m_assembler.setPosition(m_lineNumber, m_baseOffset + offset);
+    m_lineNumber += (line.data() == m_unfolded.data()) ? countLines(m_line, m_pos) : 1;
+    return true;
+}
+
+std::vector<vCard> TextBufferReader::parseCards()
+{
+    std::vector<vCard> vcards;
+    vCard current;
+    while(readCard(current))
+        vcards.push_back(std::move(current));
+
+    return vcards;
+}
+
+std::vector<vCard> TextBufferReader::parseCards(unsigned threads)
+{
+    if(threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    size_t size = m_end - m_pos;
+    size_t chunk_size = std::max(VC_MIN_CHUNK_SIZE, size / (threads * VC_CHUNKS_PER_THREAD) + 1);
+    if(threads == 1 || size <= chunk_size)
+        return parseCards();
+
+    std::vector<const char*> bounds;
+    bounds.push_back(m_pos);
+    while(bounds.back() != m_end)
+    {
+        const char *from = bounds.back() + std::min(chunk_size, static_cast<size_t>(m_end - bounds.back()));
+        bounds.push_back(findCardBoundary(from, m_begin, m_end));
+    }
+
+    size_t chunks = bounds.size() - 1;
+    std::vector<std::vector<vCard>> results(chunks);
+    std::vector<std::exception_ptr> errors(chunks);
+    std::atomic<size_t> next(0);
+
+    // diagnostics are collected per chunk and reported in the order of the input,
+    // the numbers of the first lines of chunks are needed only for them
+    vCardDiagnosticSink *sink = m_assembler.diagnostics();
+    std::vector<vCardDiagnosticList> diagnostics(sink ? chunks : 0);
+    std::vector<size_t> first_lines(chunks, m_lineNumber);
+    for(size_t i = 1; sink && i < chunks; i++)
+        first_lines[i] = first_lines[i - 1] + countLines(bounds[i - 1], bounds[i]);
+
+    auto worker = [&]() {
+        size_t i;
+        while((i = next++) < chunks)
         {
-            // Check data (PHOTO), (SOUND)
-            if(line.find("X-CUSTOM") != std::string::npos || line.find("PHOTO") != std::string::npos || line.find("SOUND") != std::string::npos)
-            {
-                trySkipContent = true;
-                continue;
-            }
-            if(line.empty() || trySkipContent && line.at(0) == ' ')
-            {
-                continue;
-            }
             try
             {
-                vCardProperty prop = TextReader::parseProperty(line);
-                current.addProperty(prop);
+                TextBufferReader reader(bounds[i], bounds[i + 1] - bounds[i]);
+                reader.m_owner = m_owner;
+                reader.m_assembler.setOwner(m_owner);
+                reader.m_lineNumber = first_lines[i];
+                reader.setProjection(m_assembler.projection());
+                reader.m_assembler.setExtensionHandlers(m_assembler.extensionHandlers());
+                reader.m_baseOffset = m_baseOffset + (bounds[i] - m_begin);
+                if(sink)
+                    reader.setDiagnostics(&diagnostics[i]);
+                results[i] = reader.parseCards();
             }
-            catch(std::exception)
+            catch(...)
             {
-                continue;
+                errors[i] = std::current_exception();
             }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(unsigned t = 1; t < std::min<size_t>(threads, chunks); t++)
+        pool.emplace_back(worker);
+    worker();
+    for(std::thread& t : pool)
+        t.join();
 
-            trySkipContent = false;
+    m_pos = m_end;
+
+    size_t total = 0;
+    for(size_t i = 0; i < chunks; i++)
+    {
+        if(errors[i])
+            std::rethrow_exception(errors[i]);
+        total += results[i].size();
+        if(sink)
+        {
+            for(const vCardDiagnostic& d : diagnostics[i].items())
+                sink->report(d);
         }
     }
 
+    std::vector<vCard> vcards;
+    vcards.reserve(total);
+    for(std::vector<vCard>& r : results)
+        std::move(r.begin(), r.end(), std::back_inserter(vcards));
+
     return vcards;
 }
 
-TextReader &TextReader::operator>>(vCard &vCard)
+bool TextBufferReader::readCard(vCard &card)
 {
-    return *this;
+    card.clear();
+    CardBuilder builder(card);
+    vCardStringRef line;
+    while(readLine(line))
+    {
+        if(m_assembler.feed(line, lineSource(), builder))
+            return true;
+    }
+
+    m_assembler.finish();
+    return false;
 }
 
-TextReader &TextReader::operator>>(std::vector<vCard> &cards)
+size_t TextBufferReader::readBatch(vCardBatch &batch, size_t max_cards)
 {
-    return *this;
+    size_t count = 0;
+    vCardStringRef line;
+    while((max_cards == 0 || count < max_cards) && readLine(line))
+    {
+        if(m_assembler.feed(line, lineSource(), batch))
+            count++;
+    }
+
+    if(eof())
+        m_assembler.finish();
+    return count;
+}
+
+size_t TextBufferReader::parse(vCardBuilder& builder)
+{
+    size_t count = 0;
+    vCardStringRef line;
+    while(readLine(line))
+    {
+        if(m_assembler.feed(line, lineSource(), builder))
+            count++;
+    }
+
+    m_assembler.finish();
+    return count;
 }
 
 //============================================================================
 
-TextWriter &TextWriter::operator<<(vCard &vCard)
+TextPushParser::TextPushParser():
+    m_scan(0), m_consumed(0), m_lineNumber(1), m_bomChecked(false), m_skipLf(false)
+{
+}
+
+size_t TextPushParser::feed(const char *data, size_t size, std::vector<vCard>& cards)
+{
+    CardBuilder builder(m_card);
+    return parse(data, size, false, builder, &cards);
+}
+
+size_t TextPushParser::feed(const char *data, size_t size, vCardBuilder& builder)
+{
+    return parse(data, size, false, builder, nullptr);
+}
+
+size_t TextPushParser::finish(std::vector<vCard>& cards)
+{
+    CardBuilder builder(m_card);
+    return parse(nullptr, 0, true, builder, &cards);
+}
+
+size_t TextPushParser::finish(vCardBuilder& builder)
+{
+    return parse(nullptr, 0, true, builder, nullptr);
+}
+
+size_t TextPushParser::parse(const char *data, size_t size, bool eof, vCardBuilder& builder, std::vector<vCard> *cards)
 {
-    *m_os << VC_BEGIN_TOKEN << VC_END_LINE_TOKEN;
-    *m_os << "VERSION:" << vCard.getVersionStr() << VC_END_LINE_TOKEN;
+    m_buffer.append(data, size);
 
-    for(auto it = vCard.properties().begin(); it != vCard.properties().end(); ++it)
+    size_t head = 0;
+    if(!m_bomChecked)
     {
-        // TODO make line folding (split lines with length > 75)
-        *this << *it;
-        *m_os << VC_END_LINE_TOKEN;
+        if(m_buffer.size() < 3 && !eof)
+            return 0;
+        m_bomChecked = true;
+        if(m_buffer.compare(0, 3, "\xEF\xBB\xBF") == 0)
+            head = m_scan = 3;
     }
 
-    *m_os << VC_END_TOKEN << VC_END_LINE_TOKEN;
-    return *this;
+    // LF of the END line completed on the bare CR at the end of the previous chunk
+    if(m_skipLf && !m_buffer.empty())
+    {
+        m_skipLf = false;
+        if(m_buffer[head] == '\n')
+            m_scan = ++head;
+    }
+
+    size_t count = 0;
+    const char *begin = m_buffer.data(), *end = begin + m_buffer.size();
+    const char *scan = begin + m_scan;
+    while(begin + head != end)
+    {
+        // the whole line is split only once, so a long line fed by small chunks is not rescanned
+        const char *start = begin + head;
+        bool last = eof;
+        if(!eof && !findLogicalLineEnd(scan, end))
+        {
+            // END line at the end of the chunk is not folded in practice, the card is completed
+            // without waiting for the next chunk (e.g. the next message from the socket)
+            if(!isEndLine(start, end))
+                break;
+            last = true;
+            m_skipLf = end[-1] == '\r';
+        }
+
+        vCardStringRef line;
+        const char *next = splitLine(start, end, last, line, m_unfolded);
+        if(!next)
+            break;
+
+        m_assembler.setPosition(m_lineNumber, m_consumed + head);
+        m_lineNumber += (line.data() == m_unfolded.data()) ? countLines(start, next) : 1;
+        head = next - begin;
+        scan = next;
+
+        if(m_assembler.feed(line, builder))
+        {
+            count++;
+            if(cards)
+                cards->push_back(std::move(m_card));
+        }
+    }
+
+    // only the incomplete line is kept
+    m_scan = scan - begin - head;
+    m_consumed += head;
+    m_buffer.erase(0, head);
+
+    if(eof)
+    {
+        m_assembler.finish();
+        m_scan = 0;
+        m_consumed = 0;
+        m_lineNumber = 1;
+        m_bomChecked = false;
+        m_skipLf = false;
+    }
+    return count;
 }
 
-TextWriter &TextWriter::operator<<(std::vector<vCard> &cards)
+//============================================================================
+
+TextWriter::TextWriter(std::ostream& os, vCardEncoding code)
 {
-    for(auto card : cards)
+    std::ostream *target = &os;
+    if(code == UTF_16)
     {
-        *this << card;
+        m_utf16.reset(new Utf16OutBuf(os.rdbuf()));
+        m_stream.reset(new std::ostream(m_utf16.get()));
+        target = m_stream.get();
     }
 
+    m_ownSink.reset(new vCardStreamSink(*target, VC_WRITE_BLOCK));
+    m_sink = m_ownSink.get();
+}
+
+TextWriter::TextWriter(vCardOutputSink& sink):
+    m_sink(&sink)
+{
+}
+
+TextWriter::~TextWriter()
+{
+    // the stream is flushed by the converting buffer
+    m_ownSink.reset();
+    m_stream.reset();
+    m_utf16.reset();
+}
+
+TextWriter &TextWriter::operator<<(vCard &vCard)
+{
+    writeCard(vCard);
+    finishOutput();
+    return *this;
+}
+
+TextWriter &TextWriter::operator<<(std::vector<vCard> &cards)
+{
+    return write(cards, 1);
+}
+
+TextWriter &TextWriter::write(std::vector<vCard> &cards, unsigned threads)
+{
+    bool parallel = writeCardsParallel(cards.size(), threads, *m_sink,
+                                       [&cards](size_t begin, size_t end, std::string& out) {
+        vCardStringSink sink(out);
+        TextWriter(sink).writeCards(cards, begin, end);
+    });
+    if(!parallel)
+        writeCards(cards, 0, cards.size());
+
+    finishOutput();
+    if(m_utf16)
+        m_stream->flush();
     return *this;
 }
 
 TextWriter &TextWriter::operator<<(vCardProperty &p)
 {
-    if(!p.getGroup().empty())
-        *m_os << p.getGroup() << '.';
+    writeProperty(p);
+    finishOutput();
+    return *this;
+}
 
-    *m_os << p.getName();
+TextWriter &TextWriter::operator<<(vCardParamMap &p)
+{
+    writeParams(p);
+    finishOutput();
+    return *this;
+}
 
-    if(p.params().size() > 0)
+void TextWriter::writeCards(std::vector<vCard>& cards, size_t begin, size_t end)
+{
+    for(size_t i = begin; i < end; i++)
     {
-        *m_os << ';';
-        *this << p.params();
+        writeCard(cards[i]);
+        m_sink->commit();
     }
+}
 
-    *m_os << ':';
+void TextWriter::writeCard(vCard& card)
+{
+    *m_sink << VC_BEGIN_TOKEN VC_END_LINE_TOKEN "VERSION:" << card.getVersionStr() << VC_END_LINE_TOKEN;
 
-    auto it = p.values().begin();
-    while(it != p.values().end())
+    for(vCardProperty& prop : card.properties())
     {
-        *m_os << *it;
+        writeProperty(prop);
+        *m_sink << VC_END_LINE_TOKEN;
+    }
 
-        it++;
+    *m_sink << VC_END_TOKEN VC_END_LINE_TOKEN;
 
-        if(it != p.values().end())
-            *m_os << ";";
+    // UTF-16 output is flushed after every card
+    if(m_utf16)
+    {
+        m_sink->flush();
+        m_stream->flush();
     }
+}
 
-    return *this;
+void TextWriter::writeProperty(vCardProperty& p)
+{
+    // the line is kept in the buffer until it is folded
+    std::string& out = m_sink->buffer();
+    size_t start = out.size();
+    if(!p.getGroup().empty())
+    {
+        out.append(p.getGroup());
+        out += '.';
+    }
+
+    out.append(p.getName());
+
+    if(p.params().size() > 0)
+    {
+        out += ';';
+        writeParams(p.params());
+    }
+
+    out += ':';
+    if(p.isBlob())
+        p.getBlob()->appendValue(out);  // do not keep the text in the property
+    else
+        out.append(p.getValue());
+
+    foldLine(start);
 }
 
-TextWriter &TextWriter::operator<<(vCardParamMap &p)
+void TextWriter::writeParams(vCardParamMap& p)
 {
+    std::string& out = m_sink->buffer();
     auto it = p.begin();
     while(it != p.end())
     {
-        *m_os << it->first << "=";
+        out.append(it->first.str());
+        out += '=';
         size_t found = it->second.find_first_of(":;,");
         if(found == std::string::npos)
-            *m_os << it->second;
+            out.append(it->second);
         else
-            *m_os << "\"" << it->second << "\"";
+        {
+            out += '"';
+            out.append(it->second);
+            out += '"';
+        }
 
         it++;
         if(it != p.end())
-            *m_os << ";";
+            out += ';';
     }
+}
 
-    return *this;
+void TextWriter::foldLine(size_t start)
+{
+    std::string& out = m_sink->buffer();
+    size_t size = out.size() - start;
+    if(size <= VC_FOLD_LENGTH)
+        return;
+
+    m_line.assign(out, start, size);
+    out.resize(start);
+    out.reserve(start + size + size / (VC_FOLD_LENGTH - 1) * 3 + 3);
+
+    const char *p = m_line.data(), *end = p + m_line.size();
+    size_t limit = VC_FOLD_LENGTH;
+    while(static_cast<size_t>(end - p) > limit)
+    {
+        // the continuation bytes of a UTF-8 sequence are moved to the next line with its lead byte
+        size_t cut = limit;
+        while(cut > 0 && (static_cast<unsigned char>(p[cut]) & 0xC0) == 0x80)
+            cut--;
+        if(cut == 0)
+            cut = limit;    // not UTF-8
+
+        out.append(p, cut);
+        out.append(VC_END_LINE_TOKEN " ");
+        p += cut;
+        limit = VC_FOLD_LENGTH - 1;     // the leading space is counted
+    }
+    out.append(p, end - p);
+}
+
+void TextWriter::finishOutput()
+{
+    // the output to the stream is visible after every call, own sinks get it by blocks
+    if(m_ownSink)
+        m_sink->flush();
+    else
+        m_sink->commit();
 }
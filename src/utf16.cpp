@@ -0,0 +1,450 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstring>
+#include "utf16.h"
+#include "simd.h"
+
+namespace {
+
+const unsigned VC_REPLACEMENT_CHAR = 0xFFFD;
+
+// buffer of Utf16OutBuf
+const size_t VC_OUT_BUFFER = 64 * 1024;
+
+inline unsigned readUnit(const char *p, bool big_endian)
+{
+    unsigned a = static_cast<unsigned char>(p[0]), b = static_cast<unsigned char>(p[1]);
+    return big_endian ? (a << 8) | b : (b << 8) | a;
+}
+
+inline char *writeUnit(unsigned u, bool big_endian, char *dst)
+{
+    dst[big_endian ? 1 : 0] = static_cast<char>(u & 0xFF);
+    dst[big_endian ? 0 : 1] = static_cast<char>(u >> 8);
+    return dst + 2;
+}
+
+inline char *writeUtf8(unsigned cp, char *dst)
+{
+    if(cp < 0x80)
+    {
+        *dst++ = static_cast<char>(cp);
+    }
+    else if(cp < 0x800)
+    {
+        *dst++ = static_cast<char>(0xC0 | (cp >> 6));
+        *dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else if(cp < 0x10000)
+    {
+        *dst++ = static_cast<char>(0xE0 | (cp >> 12));
+        *dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    else
+    {
+        *dst++ = static_cast<char>(0xF0 | (cp >> 18));
+        *dst++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        *dst++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        *dst++ = static_cast<char>(0x80 | (cp & 0x3F));
+    }
+    return dst;
+}
+
+// ASCII block converters: convert the longest prefix of whole ASCII blocks, return the number of characters
+
+#ifndef VC_SIMD_SSE2
+size_t asciiFromUtf16Scalar(const char *src, size_t units, bool big_endian, char *dst)
+{
+    size_t i = 0;
+    for(; i < units; i++)
+    {
+        unsigned u = readUnit(src + 2 * i, big_endian);
+        if(u >= 0x80)
+            break;
+        dst[i] = static_cast<char>(u);
+    }
+    return i;
+}
+
+size_t asciiToUtf16Scalar(const char *src, size_t size, bool big_endian, char *dst)
+{
+    size_t i = 0;
+    for(; i < size && static_cast<unsigned char>(src[i]) < 0x80; i++)
+        writeUnit(static_cast<unsigned char>(src[i]), big_endian, dst + 2 * i);
+    return i;
+}
+#endif
+
+#ifdef VC_SIMD_SSE2
+inline __m128i swapBytes(__m128i v)
+{
+    return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+size_t asciiFromUtf16Sse2(const char *src, size_t units, bool big_endian, char *dst)
+{
+    const __m128i high = _mm_set1_epi16(static_cast<short>(0xFF80));
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 16 <= units; i += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i + 16));
+        if(big_endian)
+        {
+            a = swapBytes(a);
+            b = swapBytes(b);
+        }
+        __m128i non_ascii = _mm_and_si128(_mm_or_si128(a, b), high);
+        if(_mm_movemask_epi8(_mm_cmpeq_epi8(non_ascii, zero)) != 0xFFFF)
+            break;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(a, b));
+    }
+    return i;
+}
+
+size_t asciiToUtf16Sse2(const char *src, size_t size, bool big_endian, char *dst)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        if(_mm_movemask_epi8(v) != 0)
+            break;
+        __m128i lo = big_endian ? _mm_unpacklo_epi8(zero, v) : _mm_unpacklo_epi8(v, zero);
+        __m128i hi = big_endian ? _mm_unpackhi_epi8(zero, v) : _mm_unpackhi_epi8(v, zero);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 2 * i + 16), hi);
+    }
+    return i;
+}
+#endif
+
+#ifdef VC_SIMD_AVX2
+VC_TARGET_AVX2 inline __m256i swapBytes256(__m256i v)
+{
+    return _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+}
+
+VC_TARGET_AVX2 size_t asciiFromUtf16Avx2(const char *src, size_t units, bool big_endian, char *dst)
+{
+    const __m256i high = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    size_t i = 0;
+    for(; i + 32 <= units; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 2 * i + 32));
+        if(big_endian)
+        {
+            a = swapBytes256(a);
+            b = swapBytes256(b);
+        }
+        if(!_mm256_testz_si256(_mm256_or_si256(a, b), high))
+            break;
+        // packus works inside 128 bit lanes, the permutation restores the order of quarters
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    return i;
+}
+
+VC_TARGET_AVX2 size_t asciiToUtf16Avx2(const char *src, size_t size, bool big_endian, char *dst)
+{
+    size_t i = 0;
+    for(; i + 32 <= size; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        if(_mm256_movemask_epi8(v) != 0)
+            break;
+        __m256i lo = _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v));
+        __m256i hi = _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1));
+        if(big_endian)
+        {
+            lo = _mm256_slli_epi16(lo, 8);
+            hi = _mm256_slli_epi16(hi, 8);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + 2 * i + 32), hi);
+    }
+    return i;
+}
+#endif
+
+typedef size_t (*AsciiFunc)(const char *, size_t, bool, char *);
+
+AsciiFunc selectAsciiFromUtf16()
+{
+#ifdef VC_SIMD_AVX2
+    if(cpuHasAvx2())
+        return asciiFromUtf16Avx2;
+#endif
+#ifdef VC_SIMD_SSE2
+    return asciiFromUtf16Sse2;
+#else
+    return asciiFromUtf16Scalar;
+#endif
+}
+
+AsciiFunc selectAsciiToUtf16()
+{
+#ifdef VC_SIMD_AVX2
+    if(cpuHasAvx2())
+        return asciiToUtf16Avx2;
+#endif
+#ifdef VC_SIMD_SSE2
+    return asciiToUtf16Sse2;
+#else
+    return asciiToUtf16Scalar;
+#endif
+}
+
+const AsciiFunc asciiFromUtf16 = selectAsciiFromUtf16();
+const AsciiFunc asciiToUtf16 = selectAsciiToUtf16();
+
+} // namespace
+
+// =================================================================
+
+TextEncoding detectEncoding(const char *data, size_t size, vCardEncoding code, size_t& bom_size)
+{
+    const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+    bom_size = 0;
+    if(size >= 3 && p[0] == 0xEF && p[1] == 0xBB && p[2] == 0xBF)
+    {
+        bom_size = 3;
+        return VC_TEXT_UTF8;
+    }
+
+    if(size >= 2)
+    {
+        if(p[0] == 0xFF && p[1] == 0xFE)
+        {
+            bom_size = 2;
+            return VC_TEXT_UTF16LE;
+        }
+        if(p[0] == 0xFE && p[1] == 0xFF)
+        {
+            bom_size = 2;
+            return VC_TEXT_UTF16BE;
+        }
+        if(p[0] != 0 && p[1] == 0)
+            return VC_TEXT_UTF16LE;
+        if(p[0] == 0 && p[1] != 0)
+            return VC_TEXT_UTF16BE;
+    }
+
+    return code == UTF_16 ? VC_TEXT_UTF16LE : VC_TEXT_UTF8;
+}
+
+size_t utf16ToUtf8(const char *src, size_t size, bool big_endian, bool final, char *dst, size_t& consumed)
+{
+    char *out = dst;
+    size_t i = 0;
+    while(i + 2 <= size)
+    {
+        size_t ascii = asciiFromUtf16(src + i, (size - i) / 2, big_endian, out);
+        i += 2 * ascii;
+        out += ascii;
+        if(i + 2 > size)
+            break;
+
+        unsigned u = readUnit(src + i, big_endian);
+        if(u < 0xD800 || u > 0xDFFF)
+        {
+            out = writeUtf8(u, out);
+            i += 2;
+            continue;
+        }
+
+        if(u <= 0xDBFF)
+        {
+            if(i + 4 > size)
+            {
+                if(!final)
+                    break;
+                out = writeUtf8(VC_REPLACEMENT_CHAR, out);
+                i += 2;
+                continue;
+            }
+
+            unsigned low = readUnit(src + i + 2, big_endian);
+            if(low >= 0xDC00 && low <= 0xDFFF)
+            {
+                out = writeUtf8(0x10000 + ((u - 0xD800) << 10) + (low - 0xDC00), out);
+                i += 4;
+                continue;
+            }
+        }
+
+        // unpaired surrogate
+        out = writeUtf8(VC_REPLACEMENT_CHAR, out);
+        i += 2;
+    }
+
+    if(final && i < size)
+    {
+        // odd byte at the end
+        out = writeUtf8(VC_REPLACEMENT_CHAR, out);
+        i = size;
+    }
+
+    consumed = i;
+    return out - dst;
+}
+
+size_t utf8ToUtf16(const char *src, size_t size, bool big_endian, bool final, char *dst, size_t& consumed)
+{
+    const unsigned char *s = reinterpret_cast<const unsigned char*>(src);
+    char *out = dst;
+    size_t i = 0;
+    while(i < size)
+    {
+        size_t ascii = asciiToUtf16(src + i, size - i, big_endian, out);
+        i += ascii;
+        out += 2 * ascii;
+        if(i == size)
+            break;
+
+        unsigned c = s[i];
+        if(c < 0x80)
+        {
+            out = writeUnit(c, big_endian, out);
+            i++;
+            continue;
+        }
+
+        size_t len = 0;
+        unsigned cp = 0, min = 0;
+        if(c >= 0xC2 && c <= 0xDF)
+        {
+            len = 2;
+            cp = c & 0x1F;
+            min = 0x80;
+        }
+        else if(c >= 0xE0 && c <= 0xEF)
+        {
+            len = 3;
+            cp = c & 0x0F;
+            min = 0x800;
+        }
+        else if(c >= 0xF0 && c <= 0xF4)
+        {
+            len = 4;
+            cp = c & 0x07;
+            min = 0x10000;
+        }
+
+        if(len > 0 && i + len > size && !final)
+            break;
+
+        size_t k = 1;
+        for(; len > 0 && k < len && i + k < size && (s[i + k] & 0xC0) == 0x80; k++)
+            cp = (cp << 6) | (s[i + k] & 0x3F);
+
+        if(len == 0 || k < len || cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+        {
+            out = writeUnit(VC_REPLACEMENT_CHAR, big_endian, out);
+            i++;
+            continue;
+        }
+
+        if(cp >= 0x10000)
+        {
+            cp -= 0x10000;
+            out = writeUnit(0xD800 + (cp >> 10), big_endian, out);
+            out = writeUnit(0xDC00 + (cp & 0x3FF), big_endian, out);
+        }
+        else
+        {
+            out = writeUnit(cp, big_endian, out);
+        }
+        i += len;
+    }
+
+    consumed = i;
+    return out - dst;
+}
+
+std::string utf16ToUtf8(const char *src, size_t size, bool big_endian)
+{
+    std::string result(utf16ToUtf8Size(size), '\0');
+    size_t consumed;
+    result.resize(utf16ToUtf8(src, size, big_endian, true, &result[0], consumed));
+    return result;
+}
+
+// =================================================================
+
+Utf16OutBuf::Utf16OutBuf(std::streambuf *target):
+    m_target(target), m_buffer(VC_OUT_BUFFER, '\0'), m_bom(false)
+{
+    setp(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+}
+
+Utf16OutBuf::~Utf16OutBuf()
+{
+    if(flushBuffer(true))
+        m_target->pubsync();
+}
+
+Utf16OutBuf::int_type Utf16OutBuf::overflow(int_type c)
+{
+    if(!flushBuffer(false))
+        return traits_type::eof();
+
+    if(!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+int Utf16OutBuf::sync()
+{
+    return (flushBuffer(false) && m_target->pubsync() == 0) ? 0 : -1;
+}
+
+bool Utf16OutBuf::flushBuffer(bool final)
+{
+    size_t size = pptr() - pbase();
+    if(size == 0)
+        return true;
+
+    if(!m_bom)
+    {
+        m_bom = true;
+        if(m_target->sputn("\xFF\xFE", 2) != 2)
+            return false;
+    }
+
+    m_converted.resize(utf8ToUtf16Size(size));
+    size_t consumed;
+    std::streamsize n = utf8ToUtf16(pbase(), size, false, final, &m_converted[0], consumed);
+    if(m_target->sputn(m_converted.data(), n) != n)
+        return false;
+
+    // incomplete character waits for the rest of its bytes
+    size_t rest = size - consumed;
+    std::memmove(&m_buffer[0], pbase() + consumed, rest);
+    setp(&m_buffer[0], &m_buffer[0] + m_buffer.size());
+    pbump(static_cast<int>(rest));
+    return true;
+}
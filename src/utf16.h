@@ -0,0 +1,92 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef VCARD_UTF16_H
+#define VCARD_UTF16_H
+
+#include <cstddef>
+#include <streambuf>
+#include <string>
+#include "text_io.h"
+
+enum TextEncoding {
+    VC_TEXT_UTF8,
+    VC_TEXT_UTF16LE,
+    VC_TEXT_UTF16BE
+};
+
+/**
+ * Detects encoding of the input by its beginning: BOM or zero byte of the first character
+ * (vCard always starts with ASCII "BEGIN"). Without any of them UTF_16 means little endian.
+ * @param bom_size Is set to the size of the BOM which should be skipped
+ */
+TextEncoding detectEncoding(const char *data, size_t size, vCardEncoding code, size_t& bom_size);
+
+/**
+ * Converts UTF-16 to UTF-8, invalid code units are replaced with U+FFFD. ASCII is converted
+ * by blocks with AVX2 or SSE2, the implementation is selected at runtime.
+ * @param dst Must have space for utf16ToUtf8Size(size) bytes
+ * @param final False if more input follows: incomplete character at the end is not consumed
+ * @param consumed Is set to the number of consumed input bytes
+ * @return The number of written bytes
+ */
+size_t utf16ToUtf8(const char *src, size_t size, bool big_endian, bool final, char *dst, size_t& consumed);
+
+static inline size_t utf16ToUtf8Size(size_t size)
+{
+    return size / 2 * 3 + 3;
+}
+
+/**
+ * Converts UTF-8 to UTF-16, the same rules as utf16ToUtf8()
+ * @param dst Must have space for utf8ToUtf16Size(size) bytes
+ */
+size_t utf8ToUtf16(const char *src, size_t size, bool big_endian, bool final, char *dst, size_t& consumed);
+
+static inline size_t utf8ToUtf16Size(size_t size)
+{
+    return size * 2 + 2;
+}
+
+/**
+ * Converts whole UTF-16 text to UTF-8
+ */
+std::string utf16ToUtf8(const char *src, size_t size, bool big_endian);
+
+/**
+ * @brief Output buffer which converts written UTF-8 text to UTF-16LE with BOM
+ * and passes it to the target stream buffer
+ */
+class Utf16OutBuf : public std::streambuf {
+public:
+    explicit Utf16OutBuf(std::streambuf *target);
+    ~Utf16OutBuf();
+
+protected:
+    int_type overflow(int_type c) override;
+    int sync() override;
+
+    // converts the buffered text, incomplete character is kept in the buffer if not final
+    bool flushBuffer(bool final);
+
+    std::streambuf *m_target;
+    std::string m_buffer;
+    std::string m_converted;
+    bool m_bom;
+};
+
+#endif //VCARD_UTF16_H
@@ -18,8 +18,9 @@
 
 #include <string>
 #include <vector>
+#include "utils.h"
 
-std::vector<std::string> split(const std::string s, char separator, bool skip_slashed)
+std::vector<std::string> split(const std::string& s, char separator, bool skip_slashed)
 {
     // "\\" / "\," / "\;" / "\n" - ;, Backslashes, commas, and newlines must be encoded.
     std::vector<std::string> result;
@@ -43,6 +44,3 @@ std::vector<std::string> split(const std::string s, char separator, bool skip_sl
 
     return result;
 }
-
-
-
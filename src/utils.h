@@ -22,6 +22,8 @@
 #include <algorithm>
 #include <cctype>
 #include <locale>
+#include <string>
+#include <vector>
 
 // trim from start (in place)
 static inline void ltrim(std::string &s) {
@@ -53,7 +55,7 @@ static inline void tolower(std::string &s) {
                    [](unsigned char c){ return std::tolower(c); });
 }
 
-std::vector<std::string> split(const std::string s, char separator, bool skip_slashed = false);
+std::vector<std::string> split(const std::string& s, char separator, bool skip_slashed = false);
 
 
 #endif //VCARD_UTILS_H
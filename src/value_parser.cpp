@@ -0,0 +1,362 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <locale>
+#include <sstream>
+#include "value_parser.h"
+
+namespace {
+
+const double POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// all integers up to 2^53 are exact doubles
+const uint64_t MAX_EXACT_MANTISSA = uint64_t(1) << 53;
+
+// 19 digits always fit into uint64_t
+const int MAX_MANTISSA_DIGITS = 19;
+
+inline bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Reads exactly `count` digits
+ */
+bool readDigits(const char *&p, const char *end, int count, int& value)
+{
+    if(end - p < count)
+        return false;
+
+    int v = 0;
+    for(int i = 0; i < count; i++){
+        if(!isDigit(p[i]))
+            return false;
+        v = v * 10 + (p[i] - '0');
+    }
+    p += count;
+    value = v;
+    return true;
+}
+
+/**
+ * Reads exactly `count` digits of the number in [min, max] range
+ */
+bool readField(const char *&p, const char *end, int count, int min, int max, int& value)
+{
+    int v;
+    if(!readDigits(p, end, count, v) || v < min || v > max)
+        return false;
+    value = v;
+    return true;
+}
+
+inline bool skip(const char *&p, const char *end, char c)
+{
+    if(p < end && *p == c){
+        p++;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Slow path for long mantissas and big exponents, the classic locale makes '.' the separator
+ */
+bool parseDecimalSlow(const char *begin, const char *end, double& value)
+{
+    std::istringstream is(std::string(begin, end));
+    is.imbue(std::locale::classic());
+    is >> value;
+    return !is.fail();
+}
+
+/**
+ * Reads the day of the month. The month 0 is not known (---DD), the year 0 is not known
+ * either (--MMDD) and is a leap year, so February 29 is accepted then.
+ */
+bool readDay(const char *&p, const char *end, vCardDateTime& result)
+{
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    int max = 31;
+    if(result.month > 0){
+        int year = result.year;
+        bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+        max = days[result.month - 1] + (result.month == 2 && leap ? 1 : 0);
+    }
+    return readField(p, end, 2, 1, max, result.day);
+}
+
+bool parseDate(const char *&p, const char *end, vCardDateTime& result)
+{
+    if(end - p >= 2 && p[0] == '-' && p[1] == '-'){
+        // --MMDD, --MM-DD, ---DD
+        p += 2;
+        if(skip(p, end, '-'))
+            return readDay(p, end, result);
+        if(!readField(p, end, 2, 1, 12, result.month))
+            return false;
+        if(p == end || *p == 'T')
+            return true;
+        skip(p, end, '-');
+        return readDay(p, end, result);
+    }
+
+    // YYYY, YYYY-MM, YYYYMMDD, YYYY-MM-DD
+    if(!readDigits(p, end, 4, result.year))
+        return false;
+    if(p == end || *p == 'T')
+        return true;
+    bool extended = skip(p, end, '-');
+    if(!readField(p, end, 2, 1, 12, result.month))
+        return false;
+    if(p == end || *p == 'T')
+        return extended;
+    if(extended && !skip(p, end, '-'))
+        return false;
+    return readDay(p, end, result);
+}
+
+bool parseTime(const char *&p, const char *end, vCardDateTime& result)
+{
+    // HH, HHMM, HHMMSS, HH:MM, HH:MM:SS
+    if(!readField(p, end, 2, 0, 23, result.hour))
+        return false;
+    if(p == end || !(isDigit(*p) || *p == ':'))
+        return true;
+    bool extended = skip(p, end, ':');
+    if(!readField(p, end, 2, 0, 59, result.minute))
+        return false;
+    if(p == end || !(isDigit(*p) || *p == ':'))
+        return true;
+    if(extended != skip(p, end, ':'))
+        return false;
+    if(!readField(p, end, 2, 0, 60, result.second))
+        return false;
+
+    if(p < end && (*p == '.' || *p == ',')){
+        p++;
+        if(p == end || !isDigit(*p))
+            return false;
+        while(p < end && isDigit(*p))
+            p++;
+    }
+    return true;
+}
+
+bool parseZone(const char *&p, const char *end, vCardDateTime& result)
+{
+    if(skip(p, end, 'Z')){
+        result.hasZone = true;
+        return true;
+    }
+
+    int sign = *p == '-' ? -1 : 1;
+    if(!skip(p, end, '+') && !skip(p, end, '-'))
+        return false;
+
+    int hours, minutes = 0;
+    if(!readField(p, end, 2, 0, 23, hours))
+        return false;
+    if(p < end){
+        skip(p, end, ':');
+        if(!readField(p, end, 2, 0, 59, minutes))
+            return false;
+    }
+
+    result.hasZone = true;
+    result.zone = sign * (hours * 60 + minutes);
+    return true;
+}
+
+} // namespace
+
+bool parseDecimal(const char *&p, const char *end, double& value)
+{
+    const char *begin = p;
+    const char *s = p;
+    bool negative = false;
+    if(s < end && (*s == '-' || *s == '+'))
+        negative = *s++ == '-';
+
+    uint64_t mantissa = 0;
+    int digits = 0;             // significant digits in the mantissa
+    int exponent = 0;
+    bool any = false;
+    bool truncated = false;
+
+    for(; s < end && isDigit(*s); s++){
+        any = true;
+        if(digits < MAX_MANTISSA_DIGITS){
+            mantissa = mantissa * 10 + (*s - '0');
+            digits += mantissa != 0;
+        }
+        else{
+            exponent++;
+            truncated |= *s != '0';
+        }
+    }
+
+    if(s < end && *s == '.'){
+        const char *dot = s++;
+        for(; s < end && isDigit(*s); s++){
+            any = true;
+            if(digits < MAX_MANTISSA_DIGITS){
+                mantissa = mantissa * 10 + (*s - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+            else
+                truncated |= *s != '0';
+        }
+        if(!any)
+            s = dot;
+    }
+
+    if(!any)
+        return false;
+
+    if(s < end && (*s == 'e' || *s == 'E')){
+        const char *e = s + 1;
+        bool negative_exp = false;
+        if(e < end && (*e == '-' || *e == '+'))
+            negative_exp = *e++ == '-';
+        if(e < end && isDigit(*e)){
+            int exp_value = 0;
+            for(; e < end && isDigit(*e); e++)
+                if(exp_value < 10000)
+                    exp_value = exp_value * 10 + (*e - '0');
+            exponent += negative_exp ? -exp_value : exp_value;
+            s = e;
+        }
+    }
+
+    p = s;
+    if(truncated || mantissa > MAX_EXACT_MANTISSA || exponent < -22 || exponent > 22)
+        return parseDecimalSlow(begin, s, value);
+
+    // both operands are exact, so the result is correctly rounded
+    double v = static_cast<double>(mantissa);
+    v = exponent < 0 ? v / POWERS_OF_TEN[-exponent] : v * POWERS_OF_TEN[exponent];
+    value = negative ? -v : v;
+    return true;
+}
+
+bool parseGeoPosition(vCardStringRef value, vCardGeoPosition& result)
+{
+    value = value.trimmed();
+    if(value.size() > 4 && value.substr(0, 4).equalsNoCase("geo:"))
+        value = value.substr(4);
+
+    const char *p = value.data();
+    const char *end = p + value.size();
+    double latitude, longitude;
+    if(!parseDecimal(p, end, latitude))
+        return false;
+    while(p < end && *p == ' ')
+        p++;
+    if(!skip(p, end, ',') && !skip(p, end, ';'))
+        return false;
+    while(p < end && *p == ' ')
+        p++;
+    if(!parseDecimal(p, end, longitude))
+        return false;
+    if(p < end && *p != ',' && *p != ';')
+        return false;
+
+    if(latitude < -90 || latitude > 90 || longitude < -180 || longitude > 180)
+        return false;
+
+    result.latitude = latitude;
+    result.longitude = longitude;
+    return true;
+}
+
+bool parseDateTime(vCardStringRef value, vCardDateTime& result)
+{
+    value = value.trimmed();
+    const char *p = value.data();
+    const char *end = p + value.size();
+    vCardDateTime r;
+
+    if(p < end && *p != 'T'){
+        if(!parseDate(p, end, r))
+            return false;
+        r.hasDate = true;
+    }
+
+    if(skip(p, end, 'T')){
+        if(!parseTime(p, end, r))
+            return false;
+        r.hasTime = true;
+        if(p < end && !parseZone(p, end, r))
+            return false;
+    }
+
+    if(p != end || !(r.hasDate || r.hasTime))
+        return false;
+
+    result = r;
+    return true;
+}
+
+void parseTelephone(vCardStringRef value, vCardTelephone& result)
+{
+    value = value.trimmed();
+    if(value.size() > 4 && value.substr(0, 4).equalsNoCase("tel:")){
+        value = value.substr(4);
+        size_t params = value.find(';');
+        if(params != vCardStringRef::npos){
+            std::vector<vCardStringRef> list = value.substr(params + 1).split(';');
+            for(vCardStringRef param : list)
+                if(param.size() > 4 && param.substr(0, 4).equalsNoCase("ext="))
+                    result.extension = param.substr(4).str();
+            value = value.substr(0, params);
+        }
+    }
+
+    result.number.clear();
+    for(size_t i = 0; i < value.size(); i++){
+        char c = value[i];
+        if(isDigit(c) || c == '*' || c == '#' || (c == '+' && result.number.empty()))
+            result.number += c;
+    }
+}
+
+void unescapeText(vCardStringRef value, std::string& out)
+{
+    const char *p = value.data();
+    const char *end = p + value.size();
+    while(p < end){
+        const char *slash = static_cast<const char*>(std::memchr(p, '\\', end - p));
+        if(!slash || slash + 1 == end){
+            out.append(p, end - p);
+            return;
+        }
+
+        out.append(p, slash - p);
+        char c = slash[1];
+        out += (c == 'n' || c == 'N') ? '\n' : c;
+        p = slash + 2;
+    }
+}
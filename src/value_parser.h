@@ -0,0 +1,53 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef VCARD_VALUE_PARSER_H
+#define VCARD_VALUE_PARSER_H
+
+#include <string>
+#include "string_ref.h"
+#include "vcard.h"
+
+/**
+ * Parses decimal number ("-122.082932", "1.5e3") starting at `p`, independent of the current
+ * locale. Numbers with up to 15 significant digits are converted without strtod.
+ * @return false if there are no digits, `p` is moved after the number otherwise
+ */
+bool parseDecimal(const char *&p, const char *end, double& value);
+
+/**
+ * Parses GEO value, "geo:" URI parameters (";u=10") and altitude are ignored
+ */
+bool parseGeoPosition(vCardStringRef value, vCardGeoPosition& result);
+
+/**
+ * Parses date, date-time, time ("T102200Z") or timestamp value, basic and extended formats
+ * of RFC 6350 and ISO 8601 dates of vCard 3.0. Fractions of seconds are ignored.
+ */
+bool parseDateTime(vCardStringRef value, vCardDateTime& result);
+
+/**
+ * Parses TEL value, plain text or "tel:" URI
+ */
+void parseTelephone(vCardStringRef value, vCardTelephone& result);
+
+/**
+ * Appends text value with "\n", "\,", "\;" and "\\" escapes replaced
+ */
+void unescapeText(vCardStringRef value, std::string& out);
+
+#endif //VCARD_VALUE_PARSER_H
@@ -21,47 +21,309 @@
 #include <sstream>
 #include <algorithm>
 #include "vcard.h"
+#include "vcard_blob.h"
 #include "utils.h"
+#include "value_parser.h"
 
+//==============================================================================
+
+namespace {
+
+const char *known_names[] = {
+    "",
+    // RFC 6350 properties
+    "BEGIN", "END", "SOURCE", "KIND", "XML", "FN", "N", "NICKNAME", "PHOTO", "BDAY", "ANNIVERSARY",
+    "GENDER", "ADR", "TEL", "EMAIL", "IMPP", "LANG", "TZ", "GEO", "TITLE", "ROLE", "LOGO", "ORG",
+    "MEMBER", "RELATED", "CATEGORIES", "NOTE", "PRODID", "REV", "SOUND", "UID", "CLIENTPIDMAP",
+    "URL", "VERSION", "KEY", "FBURL", "CALADRURI", "CALURI",
+    // RFC 2426 and RFC 6474, RFC 6715 properties
+    "NAME", "PROFILE", "MAILER", "LABEL", "AGENT", "CLASS", "SORT-STRING", "BIRTHPLACE", "DEATHPLACE",
+    "DEATHDATE", "EXPERTISE", "HOBBY", "INTEREST", "ORG-DIRECTORY",
+    // parameters
+    "LANGUAGE", "VALUE", "PREF", "ALTID", "PID", "TYPE", "MEDIATYPE", "CALSCALE", "SORT-AS",
+    "ENCODING", "CHARSET", "CONTEXT", "LEVEL", "INDEX", "CC",
+    // common extensions of Apple, Google, Microsoft and Evolution exports
+    "X-ABLABEL", "X-ABADR", "X-ABUID", "X-ABDATE", "X-ABRELATEDNAMES", "X-ABSHOWAS", "X-ABPERSON",
+    "X-APPLE-SUBLOCALITY", "X-APPLE-SUBADMINISTRATIVEAREA", "X-SOCIALPROFILE", "X-IMAGETYPE",
+    "X-IMAGEHASH", "X-SHARED-PHOTO-DISPLAY-PREF", "X-AIM", "X-ICQ", "X-JABBER", "X-MSN", "X-YAHOO",
+    "X-SKYPE", "X-GOOGLE-TALK", "X-QQ", "X-GADUGADU", "X-PHONETIC-FIRST-NAME", "X-PHONETIC-MIDDLE-NAME",
+    "X-PHONETIC-LAST-NAME", "X-PHONETIC-ORG", "X-MAIDENNAME", "X-GENDER", "X-ANNIVERSARY",
+    "X-ASSISTANT", "X-MANAGER", "X-SPOUSE", "X-CUSTOM", "X-MS-OL-DEFAULT-POSTAL-ADDRESS",
+    "X-MS-OL-DESIGN", "X-MS-IMADDRESS", "X-MS-CARDPICTURE", "X-EVOLUTION-FILE-AS",
+    "X-EVOLUTION-SPOUSE", "X-EVOLUTION-MANAGER", "X-EVOLUTION-ASSISTANT", "X-EVOLUTION-ANNIVERSARY",
+    "X-EVOLUTION-BLOG-URL", "X-EVOLUTION-VIDEO-URL", "X-MOZILLA-HTML", "X-SERVICE-TYPE", "X-USER"
+};
+
+const size_t known_count = sizeof(known_names) / sizeof(known_names[0]);
+
+inline size_t hashName(vCardStringRef name)
+{
+    // FNV-1a
+    size_t h = 14695981039346656037ULL;
+    for(char c : name)
+    {
+        h ^= static_cast<unsigned char>(c);
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+/**
+ * Static table of known names, open addressing hash. Immutable after construction,
+ * so lookups do not need locks.
+ */
+class KnownNames {
+public:
+    KnownNames(): m_names(known_names, known_names + known_count), m_slots(512, -1)
+    {
+        for(size_t i = 0; i < m_names.size(); i++)
+        {
+            size_t slot = hashName(m_names[i]) & (m_slots.size() - 1);
+            while(m_slots[slot] >= 0)
+                slot = (slot + 1) & (m_slots.size() - 1);
+            m_slots[slot] = static_cast<int>(i);
+        }
+    }
+
+    const std::string *find(vCardStringRef name) const
+    {
+        size_t slot = hashName(name) & (m_slots.size() - 1);
+        while(m_slots[slot] >= 0)
+        {
+            const std::string& s = m_names[m_slots[slot]];
+            if(vCardStringRef(s) == name)
+                return &s;
+            slot = (slot + 1) & (m_slots.size() - 1);
+        }
+        return nullptr;
+    }
+
+    const std::string *empty() const { return m_names.data(); }
+
+protected:
+    const std::vector<std::string> m_names;
+    std::vector<int> m_slots;
+};
+
+const KnownNames& knownNames()
+{
+    static const KnownNames names;
+    return names;
+}
+
+} // namespace
+
+vCardName::vCardName(): m_name(knownNames().empty())
+{
+}
+
+vCardName::vCardName(vCardStringRef name): m_name(knownNames().find(name))
+{
+    if(!m_name)
+        m_custom.assign(name.begin(), name.end());
+}
+
+size_t vCardName::customHash() const
+{
+    return hashName(m_custom) * 0x9E3779B97F4A7C15ULL;
+}
 
 //==============================================================================
 
-void vCardParamMap::addParam(std::string name, std::string value)
+namespace {
+
+bool hasLowercase(vCardStringRef s)
+{
+    for(char c : s)
+        if(c >= 'a' && c <= 'z')
+            return true;
+    return false;
+}
+
+// Parameter names are stored uppercased, the copy is made only for names which need it
+vCardName paramName(vCardStringRef name)
+{
+    if(!hasLowercase(name))
+        return vCardName(name);
+
+    std::string upper = name.str();
+    toupper(upper);
+    return vCardName(upper);
+}
+
+} // namespace
+
+std::pair<param_iterator, param_iterator> vCardParamMap::range(vCardStringRef name)
+{
+    // Equal names are adjacent. With a few parameters the linear scan comparing the strings
+    // is faster than the binary search or interning the name first
+    param_iterator first = m_params.begin(), last = m_params.end();
+    while(first != last && vCardStringRef(first->first.str()) != name)
+        ++first;
+
+    param_iterator it = first;
+    while(it != last && it->first == first->first)
+        ++it;
+
+    return std::make_pair(first, it);
+}
+
+void vCardParamMap::addParam(vCardStringRef name, std::string value)
+{
+    vCardName key = paramName(name);
+
+    // After the last parameter with the same name, as std::multimap::insert does
+    param_iterator pos = m_params.begin();
+    while(pos != m_params.end() && !(key < pos->first))
+        ++pos;
+
+    m_params.insert(pos, vCardParam(key, std::move(value)));
+}
+
+void vCardParamMap::setParam(vCardStringRef name, std::string value)
 {
-    toupper(name);
-    m_params.insert({name, value});
+    vCardName key = paramName(name);
+    auto r = range(key.str());
+    if(r.first != r.second){
+        r.first->second = std::move(value);
+        m_params.erase(r.first + 1, r.second);
+    } else {
+        addParam(key.str(), std::move(value));
+    }
 }
 
-void vCardParamMap::setParam(std::string name, std::string value)
+void vCardParamMap::removeParam(vCardStringRef name)
 {
-    toupper(name);
-    m_params.erase(name);
-    m_params.emplace(name, value);
+    std::string upper;
+    if(hasLowercase(name)){
+        upper = name.str();
+        toupper(upper);
+        name = upper;
+    }
+
+    auto r = range(name);
+    m_params.erase(r.first, r.second);
 }
 
-void vCardParamMap::removeParam(std::string name)
+int vCardParamMap::count(vCardStringRef name) const
 {
-    toupper(name);
-    m_params.erase(name);
+    int n = 0;
+    for(const vCardParam& p : m_params)
+        if(vCardStringRef(p.first.str()) == name)
+            n++;
+    return n;
 }
 
-std::pair<param_iterator, param_iterator> vCardParamMap::getParams(std::string name)
+std::pair<param_iterator, param_iterator> vCardParamMap::getParams(vCardStringRef name)
 {
-    return m_params.equal_range(name);
+    auto r = range(name);
+    if(r.first == r.second)
+        return std::make_pair(m_params.end(), m_params.end());
+    return r;
 }
 
 
-std::string& vCardParamMap::operator[] (std::string name)
+std::string& vCardParamMap::operator[] (vCardStringRef name)
 {
-    auto search = m_params.find(name);
-    if(search != m_params.end())
-        return search->second;
-    else
+    auto r = range(name);
+    if(r.first == r.second)
         throw std::runtime_error("param not found");
+    return r.first->second;
 }
 
 // =================================================================
 
+int64_t vCardDateTime::toUnixTime() const
+{
+    // days from civil, proleptic Gregorian calendar
+    int y = year - (month <= 2);
+    int era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = static_cast<unsigned>(y - era * 400);
+    unsigned m = month > 0 ? month : 1;
+    unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + (day > 0 ? day : 1) - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int64_t days = int64_t(era) * 146097 + doe - 719468;
+
+    return days * 86400 + hour * 3600 + minute * 60 + second - int64_t(zone) * 60;
+}
+
+/**
+ * @brief Cached typed view of the property value, shared by the copies of the property
+ */
+class vCardTypedValue {
+public:
+    enum Kind {
+        ADDRESS,
+        PERSON_NAME,
+        GEO_POSITION,
+        DATE_TIME,
+        TELEPHONE
+    };
+
+    vCardTypedValue(Kind kind): m_kind(kind), m_valid(false) {}
+    virtual ~vCardTypedValue() {}
+
+    Kind kind() const { return m_kind; }
+    bool valid() const { return m_valid; }
+
+protected:
+    Kind m_kind;
+    bool m_valid;
+};
+
+namespace {
+
+template<class T>
+class TypedValue : public vCardTypedValue {
+public:
+    template<class Parse>
+    TypedValue(Kind kind, Parse parse): vCardTypedValue(kind)
+    {
+        m_valid = parse(m_value);
+    }
+
+    T m_value;
+};
+
+/**
+ * Returns the cached value of the kind or parses it. Failures are cached too, so malformed
+ * values are not parsed again.
+ */
+template<class T, class Parse>
+const T& cachedValue(std::shared_ptr<const vCardTypedValue>& cache, vCardTypedValue::Kind kind,
+                     const char *name, Parse parse)
+{
+    if(!cache || cache->kind() != kind)
+        cache = std::make_shared<TypedValue<T>>(kind, parse);
+
+    if(!cache->valid())
+        throw std::runtime_error(std::string("Malformed ") + name + " value");
+    return static_cast<const TypedValue<T>&>(*cache).m_value;
+}
+
+/**
+ * Unescapes components of the structured value into the fields. The joined value is split
+ * as views, so the property is not switched to the split form (getValue() would join it then).
+ */
+void unescapeComponents(bool split, const std::vector<std::string>& values, const std::string& value,
+                        std::string *const *fields, size_t count)
+{
+    if(split){
+        for(size_t i = 0; i < values.size() && i < count; i++)
+            unescapeText(values[i], *fields[i]);
+        return;
+    }
+
+    std::vector<vCardStringRef> list;
+    vCardStringRef(value).split(VC_SEPARATOR_TOKEN, true, list);
+    for(size_t i = 0; i < list.size() && i < count; i++)
+        unescapeText(list[i], *fields[i]);
+}
+
+} // namespace
+
+// =================================================================
+
 const std::map<std::string, std::string> vCardProperty::property_types =
     {
         {"fn", "text"}, {"bday", "date"}, {"anniversary", "text"}, {"gender", "sex"},
@@ -72,37 +334,143 @@ const std::map<std::string, std::string> vCardProperty::property_types =
         {"caluri", "uri"}, {"source", "uri"}, {"adr", "text"}, {"n", "text"}
     };
 
-vCardProperty::vCardProperty(const std::string& name, const std::string& value)
+vCardProperty::vCardProperty(const std::string& name, std::string value):
+    m_name(name), m_value(std::move(value)), m_split(false)
 {
-    m_name = name;
-    m_values = split(value, VC_SEPARATOR_TOKEN, true);
 }
 
-vCardProperty::vCardProperty(const std::string& group, const std::string& name, const std::string& value)
+vCardProperty::vCardProperty(std::string group, const std::string& name, std::string value):
+    m_group(std::move(group)), m_name(name), m_value(std::move(value)), m_split(false)
 {
-    m_name = name;
-    m_group = group;
-    m_values = split(value, VC_SEPARATOR_TOKEN, true);
 }
 
 void vCardProperty::setParams(vCardParamMap params)
 {
-    this->m_params = params;
+    this->m_params = std::move(params);
 }
 
-std::string vCardProperty::getValue()
+const std::string& vCardProperty::getValue()
 {
-    std::stringstream s;
+    if(m_blob){
+        m_value = m_blob->value();
+        m_blob.reset();
+    }
 
-    auto it = m_values.begin();
-    while(it != m_values.end()){
-        s << *it;
-        it++;
-        if(it != m_values.end())
-            s << ";";
+    if(m_split){
+        // the list is accessible by reference, so it is joined on every call
+        m_value.clear();
+        for(size_t i = 0; i < m_values.size(); i++){
+            if(i > 0)
+                m_value += VC_SEPARATOR_TOKEN;
+            m_value += m_values[i];
+        }
     }
 
-    return s.str();
+    return m_value;
+}
+
+size_t vCardProperty::valueSize() const
+{
+    if(m_blob)
+        return 0;
+    if(!m_split)
+        return m_value.size();
+
+    size_t size = m_values.empty() ? 0 : m_values.size() - 1;
+    for(const std::string& v : m_values)
+        size += v.size();
+    return size;
+}
+
+void vCardProperty::setValue(std::string value)
+{
+    m_value = std::move(value);
+    m_values.clear();
+    m_split = false;
+    m_blob.reset();
+    m_typed.reset();
+}
+
+void vCardProperty::setBlob(std::shared_ptr<const vCardBlob> blob)
+{
+    m_blob = std::move(blob);
+    m_value.clear();
+    m_values.clear();
+    m_split = false;
+    m_typed.reset();
+}
+
+std::string vCardProperty::getBinary()
+{
+    if(m_blob)
+        return m_blob->decode();
+
+    bool base64 = false;
+    auto range = m_params.getParams("ENCODING");
+    for(auto it = range.first; it != range.second; ++it)
+        if(vCardBlob::isBase64Encoding(it->second))
+            base64 = true;
+
+    return vCardBlob::decodeValue(getValue(), base64);
+}
+
+std::vector<std::string>& vCardProperty::values()
+{
+    if(m_blob)
+        getValue();
+
+    // the list can be changed through the reference
+    m_typed.reset();
+
+    if(!m_split){
+        m_values = split(m_value, VC_SEPARATOR_TOKEN, true);
+        m_split = true;
+    }
+
+    return m_values;
+}
+
+const vCardAddress& vCardProperty::address()
+{
+    return cachedValue<vCardAddress>(m_typed, vCardTypedValue::ADDRESS, VC_ADDRESS, [this](vCardAddress& a){
+        std::string *fields[] = {&a.postOfficeBox, &a.extendedAddress, &a.street, &a.locality,
+                                 &a.region, &a.postalCode, &a.country};
+        if(m_blob)
+            getValue();
+        unescapeComponents(m_split, m_values, m_value, fields, sizeof(fields) / sizeof(fields[0]));
+        return true;
+    });
+}
+
+const vCardPersonName& vCardProperty::personName()
+{
+    return cachedValue<vCardPersonName>(m_typed, vCardTypedValue::PERSON_NAME, VC_NAME, [this](vCardPersonName& n){
+        std::string *fields[] = {&n.lastname, &n.firstname, &n.additional, &n.prefix, &n.suffix};
+        if(m_blob)
+            getValue();
+        unescapeComponents(m_split, m_values, m_value, fields, sizeof(fields) / sizeof(fields[0]));
+        return true;
+    });
+}
+
+const vCardGeoPosition& vCardProperty::geoPosition()
+{
+    return cachedValue<vCardGeoPosition>(m_typed, vCardTypedValue::GEO_POSITION, VC_GEOGRAPHIC_POSITION,
+                                         [this](vCardGeoPosition& g){ return parseGeoPosition(getValue(), g); });
+}
+
+const vCardDateTime& vCardProperty::dateTime()
+{
+    return cachedValue<vCardDateTime>(m_typed, vCardTypedValue::DATE_TIME, m_name.str().c_str(),
+                                      [this](vCardDateTime& d){ return parseDateTime(getValue(), d); });
+}
+
+const vCardTelephone& vCardProperty::telephone()
+{
+    return cachedValue<vCardTelephone>(m_typed, vCardTypedValue::TELEPHONE, VC_TELEPHONE, [this](vCardTelephone& t){
+        parseTelephone(getValue(), t);
+        return true;
+    });
 }
 
 vCardProperty & vCardProperty::operator << (const vCardParamMap &p)
@@ -151,10 +519,20 @@ vCardProperty vCardProperty::createOrganization(const std::string& name, const s
     return vCardProperty(VC_ORGANIZATION, values, params);
 }
 
+vCardProperty vCardProperty::createBinary(const std::string& name, std::string data, const std::string& type)
+{
+    vCardProperty prop(name, std::string());
+    prop.m_params.addParam("ENCODING", "b");
+    if(!type.empty())
+        prop.m_params.addParam("TYPE", type);
+    prop.setBlob(vCardBlob::fromData(std::move(data)));
+    return prop;
+}
+
 vCardProperty vCardProperty::createBirthday(const int year, const int month, const int day)
 {
-    char buffer[15];
-    sprintf(buffer, "%4d-%2d-%2d", year, month, day);
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d", year, month, day);
     return vCardProperty(VC_BIRTHDAY, buffer);
 }
 
@@ -162,35 +540,143 @@ vCardProperty vCardProperty::createBirthday(const int year, const int month, con
 
 // ======================================================================
 
-vCardProperty& vCard::operator[] (std::string name) {
-    for(vCardProperty& p: m_properties) {
-        if (p.getName() == name)
-            return p;
-    }
+vCardProperty& vCard::operator[] (vCardStringRef name) {
+    const IndexSlot *slot = findSlot(vCardName(name));
+    if(slot)
+        return m_properties[slot->first];
 
     throw std::runtime_error("Property not found");
 }
 
+vCardPropertySet vCard::getProperties(vCardStringRef name)
+{
+    const IndexSlot *slot = findSlot(vCardName(name));
+    if(!slot)
+        return vCardPropertySet();
+
+    return vCardPropertySet(m_properties.data(), m_next.data(), slot->first, slot->count);
+}
+
 vCard & vCard::operator << (const vCardProperty &p)
 {
-    m_properties.push_back(p);
+    addProperty(p);
     return *this;
 }
 
 void vCard::addProperty(const vCardProperty& property)
 {
     m_properties.push_back(property);
+    if(m_indexed)
+        indexProperty(m_properties.size() - 1);
+}
+
+void vCard::addProperty(vCardProperty&& property)
+{
+    m_properties.push_back(std::move(property));
+    if(m_indexed)
+        indexProperty(m_properties.size() - 1);
+}
+
+void vCard::removeProperty(vCardStringRef name)
+{
+    vCardName atom(name);
+
+    auto it = std::remove_if(m_properties.begin(), m_properties.end(),
+                             [&atom](const vCardProperty& p){ return p.getNameAtom() == atom; });
+    if(it != m_properties.end()){
+        m_properties.erase(it, m_properties.end());
+        // positions after the removed properties are shifted
+        m_indexed = false;
+    }
+}
+
+namespace {
+
+// The name hashes are multiplicative, so the high half is mixed into the bits used for the slot
+inline size_t slotHash(const vCardName& name)
+{
+    size_t h = name.hash();
+    return h ^ (h >> (sizeof(size_t) * 4));
+}
+
+} // namespace
+
+const vCard::IndexSlot* vCard::findSlot(const vCardName& name)
+{
+    // the vector can be changed through a reference kept from properties()
+    if(!m_indexed || m_next.size() != m_properties.size())
+        buildIndex();
+
+    const IndexSlot *slot = lookupSlot(name);
+    if(slot && !isSlotValid(*slot)){
+        buildIndex();
+        slot = lookupSlot(name);
+    }
+    return slot;
+}
+
+const vCard::IndexSlot* vCard::lookupSlot(const vCardName& name) const
+{
+    size_t mask = m_slots.size() - 1;
+    for(size_t i = slotHash(name) & mask; m_slots[i].count > 0; i = (i + 1) & mask)
+        if(m_slots[i].name == name)
+            return &m_slots[i];
+    return nullptr;
 }
 
-void vCard::removeProperty(std::string name)
+bool vCard::isSlotValid(const IndexSlot& slot) const
 {
-    auto it = m_properties.begin();
-    while(it != m_properties.end()){
-        if(it->getName() == name)
-            m_properties.erase(it);
-        else
-            it++;
+    uint32_t count = 0;
+    for(uint32_t pos = slot.first; pos != vCardPropertySet::npos; pos = m_next[pos]){
+        if(pos >= m_properties.size() || m_properties[pos].getNameAtom() != slot.name || ++count > slot.count)
+            return false;
+    }
+    return count == slot.count;
+}
+
+void vCard::buildIndex()
+{
+    // the load factor is kept at most 1/2, cards rarely have more than 16 distinct names
+    size_t size = 32;
+    while(size < m_properties.size() * 2)
+        size *= 2;
+
+    m_slots.assign(size, IndexSlot{vCardName(), vCardPropertySet::npos, vCardPropertySet::npos, 0});
+    m_next.clear();
+    m_indexedNames = 0;
+    m_indexed = true;
+
+    for(size_t pos = 0; pos < m_properties.size(); pos++)
+        indexProperty(pos);
+}
+
+void vCard::indexProperty(uint32_t pos)
+{
+    if((m_indexedNames + 1) * 2 > m_slots.size()){
+        // positions up to pos are indexed again by the rebuild
+        buildIndex();
+        return;
+    }
+
+    m_next.resize(pos + 1);
+    m_next[pos] = vCardPropertySet::npos;
+
+    const vCardName& name = m_properties[pos].getNameAtom();
+    size_t mask = m_slots.size() - 1;
+    size_t i = slotHash(name) & mask;
+    while(m_slots[i].count > 0 && m_slots[i].name != name)
+        i = (i + 1) & mask;
+
+    IndexSlot& slot = m_slots[i];
+    if(slot.count == 0){
+        slot.name = name;
+        slot.first = pos;
+        m_indexedNames++;
+    } else {
+        m_next[slot.last] = pos;
     }
+    slot.last = pos;
+    slot.count++;
 }
 
 std::string vCard::getVersionStr()
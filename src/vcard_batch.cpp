@@ -0,0 +1,202 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include "vcard_batch.h"
+#include "vcard_blob.h"
+
+// blocks grow twice up to this size
+const size_t VC_ARENA_MAX_BLOCK_SIZE = 4 * 1024 * 1024;
+
+vCardArena::vCardArena(size_t block_size):
+    m_blocks(nullptr), m_pos(nullptr), m_end(nullptr), m_blockSize(block_size), m_capacity(0)
+{
+}
+
+vCardArena::vCardArena(vCardArena&& arena):
+    m_blocks(arena.m_blocks), m_pos(arena.m_pos), m_end(arena.m_end),
+    m_blockSize(arena.m_blockSize), m_capacity(arena.m_capacity)
+{
+    arena.m_blocks = nullptr;
+    arena.m_pos = arena.m_end = nullptr;
+    arena.m_capacity = 0;
+}
+
+vCardArena& vCardArena::operator = (vCardArena&& arena)
+{
+    if(this != &arena)
+    {
+        release();
+        std::swap(m_blocks, arena.m_blocks);
+        std::swap(m_pos, arena.m_pos);
+        std::swap(m_end, arena.m_end);
+        std::swap(m_blockSize, arena.m_blockSize);
+        std::swap(m_capacity, arena.m_capacity);
+    }
+
+    return *this;
+}
+
+void *vCardArena::allocate(size_t size, size_t align)
+{
+    uintptr_t p = (reinterpret_cast<uintptr_t>(m_pos) + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    if(m_pos == nullptr || p + size > reinterpret_cast<uintptr_t>(m_end))
+    {
+        size_t block_size = std::max(m_blockSize, sizeof(Block) + size + align);
+        char *memory = static_cast<char*>(::operator new(block_size));
+
+        Block *block = reinterpret_cast<Block*>(memory);
+        block->next = m_blocks;
+        m_blocks = block;
+
+        m_pos = memory + sizeof(Block);
+        m_end = memory + block_size;
+        m_capacity += block_size;
+        if(m_blockSize < VC_ARENA_MAX_BLOCK_SIZE)
+            m_blockSize *= 2;
+
+        p = (reinterpret_cast<uintptr_t>(m_pos) + align - 1) & ~static_cast<uintptr_t>(align - 1);
+    }
+
+    m_pos = reinterpret_cast<char*>(p + size);
+    return reinterpret_cast<void*>(p);
+}
+
+vCardStringRef vCardArena::copy(vCardStringRef s)
+{
+    if(s.empty())
+        return vCardStringRef();
+
+    char *p = allocate<char>(s.size());
+    std::memcpy(p, s.data(), s.size());
+    return vCardStringRef(p, s.size());
+}
+
+void vCardArena::release()
+{
+    while(m_blocks)
+    {
+        Block *next = m_blocks->next;
+        ::operator delete(m_blocks);
+        m_blocks = next;
+    }
+
+    m_pos = m_end = nullptr;
+    m_capacity = 0;
+}
+
+// =================================================================
+
+vCardProperty vCardBatch::Property::toProperty() const
+{
+    vCardProperty prop = vCardPropertyRef::makeProperty(m_group, m_name, m_value, m_params, m_paramsCount);
+    if(m_blob)
+        prop.setBlob(*m_blob);
+    return prop;
+}
+
+const vCardBatch::Property* vCardBatch::Card::find(vCardStringRef name) const
+{
+    for(const Property& p : m_properties)
+    {
+        if(p.getName() == name)
+            return &p;
+    }
+
+    return nullptr;
+}
+
+vCard vCardBatch::Card::toCard() const
+{
+    vCard card(m_version);
+    for(const Property& p : m_properties)
+        card.addProperty(p.toProperty());
+
+    return card;
+}
+
+std::vector<vCard> vCardBatch::toCards() const
+{
+    std::vector<vCard> cards;
+    cards.reserve(m_cards.size());
+    for(const Card& c : m_cards)
+        cards.push_back(c.toCard());
+
+    return cards;
+}
+
+void vCardBatch::clear()
+{
+    m_cards.clear();
+    m_current.clear();
+    m_blobs.clear();
+    m_arena.release();
+}
+
+void vCardBatch::beginCard()
+{
+    m_current.clear();
+    m_version = VC_VER_4_0;
+}
+
+void vCardBatch::addProperty(const vCardPropertyRef& prop)
+{
+    // views point into the reader's line buffer, so everything is copied into the arena
+    // except of binary values in the owned source, they stay there as blobs
+    Property p;
+    p.m_group = m_arena.copy(prop.getGroup());
+    p.m_name = m_arena.copy(prop.getName());
+    p.m_paramsCount = prop.params().size();
+    p.m_params = nullptr;
+    p.m_blob = nullptr;
+    if(prop.isBlob() && prop.getOwner() && !prop.getSource().empty())
+    {
+        m_blobs.push_back(prop.makeBlob());
+        p.m_blob = &m_blobs.back();
+    }
+    else
+        p.m_value = m_arena.copy(prop.getValue());
+
+    if(p.m_paramsCount > 0)
+    {
+        vCardParamRef *params = m_arena.allocate<vCardParamRef>(p.m_paramsCount);
+        for(size_t i = 0; i < p.m_paramsCount; i++)
+        {
+            const vCardParamRef& param = prop.params()[i];
+            new (params + i) vCardParamRef(m_arena.copy(param.getName()), m_arena.copy(param.getValue()));
+        }
+        p.m_params = params;
+    }
+
+    m_current.push_back(p);
+}
+
+void vCardBatch::endCard()
+{
+    Property *properties = m_arena.allocate<Property>(m_current.size());
+    std::uninitialized_copy(m_current.begin(), m_current.end(), properties);
+
+    Card card;
+    card.m_version = m_version;
+    card.m_properties = vCardRange<Property>(properties, properties + m_current.size());
+    m_cards.push_back(card);
+    m_current.clear();
+}
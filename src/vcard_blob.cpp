@@ -0,0 +1,143 @@
+/**
+ * vCard simple library.
+ *
+ * Copyright (C) 2019, Ivanenko Danil.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <ostream>
+#include "vcard_blob.h"
+#include "base64.h"
+#include "line_scanner.h"
+
+namespace {
+
+// data blobs are encoded to the stream by chunks of this size (multiple of 3)
+const size_t VC_ENCODE_CHUNK = 48 * 1024;
+
+} // namespace
+
+/**
+ * Calls func for each part of the value between folds
+ */
+template<class Func>
+void vCardBlob::forEachSegment(Func func) const
+{
+    const char *p = m_line.begin() + m_valueOffset, *end = m_line.end();
+    for(;;)
+    {
+        const char *line_end = findLineEnd(p, end);
+        func(vCardStringRef(p, line_end - p));
+
+        if(end - line_end >= 3 && line_end[0] == '\r' && line_end[1] == '\n' && isFoldingChar(line_end[2]))
+            p = line_end + 3;
+        else
+            break;
+    }
+}
+
+std::shared_ptr<const vCardBlob> vCardBlob::copy(vCardStringRef line, size_t value_offset, bool base64)
+{
+    auto buffer = std::make_shared<const std::string>(line.str());
+    return std::make_shared<const vCardBlob>(buffer, vCardStringRef(*buffer), value_offset, base64);
+}
+
+std::shared_ptr<const vCardBlob> vCardBlob::fromData(std::string data)
+{
+    auto buffer = std::make_shared<const std::string>(std::move(data));
+    auto blob = std::make_shared<vCardBlob>(buffer, vCardStringRef(*buffer), 0, true);
+    blob->m_binary = true;
+    return blob;
+}
+
+std::string vCardBlob::value() const
+{
+    std::string result;
+    if(m_binary)
+    {
+        base64Encode(m_line, result);
+        return result;
+    }
+
+    result.reserve(m_line.size() - m_valueOffset);
+    forEachSegment([&result](vCardStringRef s) { result.append(s.data(), s.size()); });
+    return result;
+}
+
+void vCardBlob::writeValue(std::ostream& os) const
+{
+    if(m_binary)
+    {
+        std::string chunk;
+        for(size_t pos = 0; pos < m_line.size(); pos += VC_ENCODE_CHUNK)
+        {
+            chunk.clear();
+            base64Encode(m_line.substr(pos, VC_ENCODE_CHUNK), chunk);
+            os.write(chunk.data(), chunk.size());
+        }
+        return;
+    }
+
+    forEachSegment([&os](vCardStringRef s) { os.write(s.data(), s.size()); });
+}
+
+void vCardBlob::appendValue(std::string& out) const
+{
+    if(m_binary)
+    {
+        out.reserve(out.size() + (m_line.size() + 2) / 3 * 4);
+        base64Encode(m_line, out);
+        return;
+    }
+
+    out.reserve(out.size() + m_line.size() - m_valueOffset);
+    forEachSegment([&out](vCardStringRef s) { out.append(s.data(), s.size()); });
+}
+
+std::string vCardBlob::decode() const
+{
+    if(m_binary)
+        return m_line.str();
+
+    if(!m_base64)
+        return decodeValue(value(), false);
+
+    // base64 is decoded from the folded source without unfolding
+    std::string result;
+    result.reserve((m_line.size() - m_valueOffset) / 4 * 3 + 3);
+    Base64Decoder decoder;
+    forEachSegment([&](vCardStringRef s) { decoder.update(s, result); });
+    decoder.finish(result);
+    return result;
+}
+
+std::string vCardBlob::decodeValue(vCardStringRef value, bool base64)
+{
+    if(base64)
+        return base64Decode(value);
+
+    // RFC 2397 data URI: data:[<mediatype>][;base64],<data>
+    if(value.size() > 5 && value.substr(0, 5).equalsNoCase("data:"))
+    {
+        size_t comma = value.find(',');
+        if(comma != vCardStringRef::npos && comma >= 7 && value.substr(comma - 7, 7).equalsNoCase(";base64"))
+            return base64Decode(value.substr(comma + 1));
+    }
+
+    return value.str();
+}
+
+bool vCardBlob::isBase64Encoding(vCardStringRef encoding)
+{
+    return encoding.equalsNoCase("b") || encoding.equalsNoCase("BASE64");
+}
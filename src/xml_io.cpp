@@ -21,6 +21,7 @@
 #include <string>
 #include "xml_io.h"
 #include "utils.h"
+#include "parallel_writer.h"
 
 std::map<std::string, std::string> param_types {
     {"geo", "uri"}, {"pref", "integer"}
@@ -34,31 +35,74 @@ std::vector<std::string> property_name_fields {
         "surname", "given", "additional", "prefix", "suffix"
 };
 
+XmlWriter::XmlWriter(std::ostream& os):
+    m_ownSink(new vCardStreamSink(os))
+{
+    m_sink = m_ownSink.get();
+}
+
 XmlWriter & XmlWriter::operator << (vCard & vCard)
 {
-    *m_os << "<vcard>";
+    writeCard(vCard);
+    finishOutput();
+    return *this;
+}
 
-    for(auto it = vCard.properties().begin(); it != vCard.properties().end(); ++it){
-        *this << *it;
-    }
+XmlWriter & XmlWriter::operator << (std::vector<vCard> & cards)
+{
+    return write(cards, 1);
+}
+
+XmlWriter & XmlWriter::write(std::vector<vCard> & cards, unsigned threads)
+{
+    *m_sink << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+    *m_sink << "<vcards xmlns=\"urn:ietf:params:xml:ns:vcard-4.0\">";
 
-    *m_os << "</vcard>";
+    bool parallel = writeCardsParallel(cards.size(), threads, *m_sink,
+                                       [&cards](size_t begin, size_t end, std::string& out){
+        vCardStringSink sink(out);
+        XmlWriter(sink).writeCards(cards, begin, end);
+    });
+    if(!parallel)
+        writeCards(cards, 0, cards.size());
+
+    *m_sink << "</vcards>";
+    finishOutput();
 
     return *this;
 }
 
-XmlWriter & XmlWriter::operator << (std::vector<vCard> & cards)
+XmlWriter & XmlWriter::operator << (vCardProperty & prop)
+{
+    writeProperty(prop);
+    finishOutput();
+    return *this;
+}
+
+XmlWriter & XmlWriter::operator << (vCardParamMap & p)
 {
-    *m_os << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
-    *m_os << "<vcards xmlns=\"urn:ietf:params:xml:ns:vcard-4.0\">";
+    writeParams(p);
+    finishOutput();
+    return *this;
+}
 
-    for(auto card: cards){
-        *this << card;
+void XmlWriter::writeCards(std::vector<vCard>& cards, size_t begin, size_t end)
+{
+    for(size_t i = begin; i < end; i++){
+        writeCard(cards[i]);
+        m_sink->commit();
     }
+}
 
-    *m_os << "</vcards>";
+void XmlWriter::writeCard(vCard & vCard)
+{
+    *m_sink << "<vcard>";
 
-    return *this;
+    for(auto it = vCard.properties().begin(); it != vCard.properties().end(); ++it){
+        writeProperty(*it);
+    }
+
+    *m_sink << "</vcard>";
 }
 
 std::string XmlWriter::get_property_type(std::string property_name, int count)
@@ -80,12 +124,12 @@ std::string XmlWriter::get_property_type(std::string property_name, int count)
     return type;
 }
 
-XmlWriter & XmlWriter::operator << (vCardProperty & prop)
+void XmlWriter::writeProperty(vCardProperty & prop)
 {
-    *m_os << "<" << prop.getName() << ">";
+    *m_sink << "<" << prop.getName() << ">";
 
     if(prop.params().size() > 0){
-        *this << prop.params();
+        writeParams(prop.params());
     }
 
     int count=0;
@@ -94,43 +138,50 @@ XmlWriter & XmlWriter::operator << (vCardProperty & prop)
         std::string type = get_property_type(prop.getName(), count);
 
         if(it->size() == 0){
-            *m_os << "<" << type << "/>";
+            *m_sink << "<" << type << "/>";
         } else {
-            *m_os << "<" << type << ">" << *it << "</" << type << ">";
+            *m_sink << "<" << type << ">" << *it << "</" << type << ">";
         }
 
         it++;
         count++;
     }
 
-    *m_os << "</" << prop.getName() << ">";
-
-    return *this;
+    *m_sink << "</" << prop.getName() << ">";
 }
 
-XmlWriter & XmlWriter::operator << (vCardParamMap & p)
+void XmlWriter::writeParams(vCardParamMap & p)
 {
     if(p.size() == 0)
-        return *this;
+        return;
 
-    *m_os << "<parameters>";
+    *m_sink << "<parameters>";
     auto it = p.begin();
     while(it != p.end()){
-        *m_os << "<" << it->first << ">";
+        *m_sink << "<" << it->first.str() << ">";
 
         std::string type("text");
         std::string name(it->first);
         tolower(name);
-        if(param_types.find(name) != param_types.end())
-            type = param_types[name];
-        *m_os << "<" << type << ">" << it->second << "</" << type << ">";
-        *m_os << "</" << it->first << ">";
+        // the map is shared by the threads of write(), so it is not changed by operator[]
+        auto found = param_types.find(name);
+        if(found != param_types.end())
+            type = found->second;
+        *m_sink << "<" << type << ">" << it->second << "</" << type << ">";
+        *m_sink << "</" << it->first.str() << ">";
         it++;
     }
 
-    *m_os << "</parameters>";
+    *m_sink << "</parameters>";
+}
 
-    return *this;
+void XmlWriter::finishOutput()
+{
+    // the output to the stream is visible after every call, own sinks get it by blocks
+    if(m_ownSink)
+        m_sink->flush();
+    else
+        m_sink->commit();
 }
 
 // ================================================================================
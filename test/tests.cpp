@@ -16,6 +16,8 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <cstdio>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include "catch.hpp"
@@ -23,6 +25,8 @@
 #include "text_io.h"
 #include "xml_io.h"
 #include "json_io.h"
+#include "vcard_batch.h"
+#include "vcard_blob.h"
 
 using namespace Catch;
 
@@ -47,6 +51,39 @@ TEST_CASE( "vCardParamMap", "[params]" ) {
         params.clear();
         CHECK(params.is_empty());
     }
+    SECTION("multimap order beyond inline capacity"){
+        vCardParamMap params;
+        params.addParam("type", "home");
+        params.addParam("PREF", "1");
+        params.addParam("TYPE", "voice");
+        params.addParam("LABEL", "x");
+        params.addParam("TYPE", "pref");
+        REQUIRE(params.size() == 5);
+
+        // sorted by name, equal names in the insertion order
+        const char *expected[][2] = {{"LABEL", "x"}, {"PREF", "1"}, {"TYPE", "home"}, {"TYPE", "voice"}, {"TYPE", "pref"}};
+        int i = 0;
+        for(param_iterator it = params.begin(); it != params.end(); ++it, ++i){
+            CHECK(it->first == expected[i][0]);
+            CHECK(it->second == expected[i][1]);
+        }
+
+        auto range = params.getParams("TYPE");
+        CHECK(std::distance(range.first, range.second) == 3);
+        CHECK(params["TYPE"] == "home");
+
+        vCardParamMap copy = params;
+        params.setParam("type", "work");
+        CHECK(params.count("TYPE") == 1);
+        CHECK(params["TYPE"] == "work");
+        CHECK(copy.count("TYPE") == 3);
+
+        vCardParamMap moved = std::move(copy);
+        CHECK(moved.size() == 5);
+        moved.removeParam("type");
+        CHECK(moved.size() == 2);
+        CHECK(moved.getParams("TYPE").first == moved.end());
+    }
     SECTION("parse input string to params"){
         std::string str("TYPE=work;PREF=1;zz=zz");
         vCardParamMap params = TextReader::parseParams(str);
@@ -72,6 +109,30 @@ TEST_CASE( "vCardParamMap", "[params]" ) {
     }
 }
 
+TEST_CASE( "vCardName", "[params]" ) {
+    vCardName tel("TEL"), tel2(std::string("TEL")), custom("X-CUSTOM-NAME-FOR-TEST");
+    CHECK(tel == tel2);
+    CHECK(tel.isKnown());
+    CHECK(&tel.str() == &tel2.str());
+    CHECK_FALSE(custom.isKnown());
+    CHECK(custom == vCardName("X-CUSTOM-NAME-FOR-TEST"));
+    CHECK(custom == "X-CUSTOM-NAME-FOR-TEST");
+    CHECK(vCardName() == "");
+
+    CHECK(custom.hash() == vCardName("X-CUSTOM-NAME-FOR-TEST").hash());
+    CHECK(custom != vCardName("X-CUSTOM-NAME-FOR-TEST2"));
+    CHECK(custom < vCardName("X-CUSTOM-NAME-FOR-TEST2"));
+    CHECK(vCardName(VC_EMAIL) < custom);
+    CHECK(vCardName(vCardStringRef("EMAIL")) == VC_EMAIL);
+
+    vCard card;
+    card << vCardProperty(VC_TELEPHONE, "1") << vCardProperty(VC_NOTE, "n") << vCardProperty(VC_TELEPHONE, "2");
+    card.removeProperty(VC_TELEPHONE);
+    REQUIRE(card.count() == 1);
+    CHECK(card[VC_NOTE].getNameAtom() == vCardName(VC_NOTE));
+    CHECK_THROWS_AS(card["X-NEVER-USED-PROPERTY"], std::runtime_error);
+}
+
 TEST_CASE( "vCardProperty", "[property]" ) {
     SECTION("test property parsing"){
         std::string str = "grp.TEL;VALUE=uri;TYPE=home:tel:+33-01-23-45-67";
@@ -88,6 +149,38 @@ TEST_CASE( "vCardProperty", "[property]" ) {
         prop = TextReader::parseProperty(str);
         CHECK(prop.values().at(vCardProperty::PostalCode) == "91921\\;-1234");
     }
+    SECTION("quotes crossing 64 bytes blocks"){
+        std::string label(70, 'a');
+        std::string str = "item2.ADR;TYPE=HOME;LABEL=\"" + label + ";b:c,d\";X-ABLABEL=\"x.y=z\";"
+                          "SORT-AS=\"Doe,John\":;;Street;City";
+        vCardPropertyRef prop;
+        TextReader::parseProperty(vCardStringRef(str), prop);
+        CHECK(prop.getGroup() == "item2");
+        CHECK(prop.getName() == "ADR");
+        CHECK(prop.getValue() == ";;Street;City");
+        REQUIRE(prop.params().size() == 5);
+        CHECK(prop.params()[1].getValue() == label + ";b:c,d");
+        CHECK(prop.params()[2].getValue() == "x.y=z");
+        CHECK(prop.params()[4].getValue() == "John");
+
+        CHECK_THROWS_AS(TextReader::parseProperty(std::string("TEL;TYPE=\"home:123")), std::runtime_error);
+        CHECK_THROWS_AS(TextReader::parseParams(std::string("LABEL=\"not closed")), std::runtime_error);
+    }
+    SECTION("lazy value splitting"){
+        vCardProperty prop("N", "Gump;Forrest;;Mr.\\;Sir;");
+        CHECK(prop.getValue() == "Gump;Forrest;;Mr.\\;Sir;");
+
+        REQUIRE(prop.values().size() == 5);
+        CHECK(prop.values()[3] == "Mr.\\;Sir");
+
+        // changes of the list are visible through getValue()
+        prop.values()[1] = "F.";
+        CHECK(prop.getValue() == "Gump;F.;;Mr.\\;Sir;");
+
+        prop.setValue("Doe;John");
+        CHECK(prop.getValue() == "Doe;John");
+        CHECK(prop.values().size() == 2);
+    }
     SECTION("property stream operator"){
         vCardProperty prop("grp", "TEL", "tel:+111-22-33");
         std::stringstream s;
@@ -118,6 +211,95 @@ TEST_CASE( "vCardProperty", "[property]" ) {
     }
 }
 
+TEST_CASE("vCardProperty typed values", "[vcard]"){
+    SECTION("structured"){
+        vCardProperty adr(VC_ADDRESS, ";;123 Main Street\\, 5;Any Town;Region;91921\\;-1234");
+        const vCardAddress& a = adr.address();
+        CHECK(a.street == "123 Main Street, 5");
+        CHECK(a.locality == "Any Town");
+        CHECK(a.postalCode == "91921;-1234");
+        CHECK(a.country.empty());
+        CHECK(&adr.address() == &a);    // cached
+
+        vCardProperty n = vCardProperty::createName("John", "Doe", "", "Mr.");
+        CHECK(n.valueSize() == std::string("Doe;John;;Mr.;").size());
+        CHECK(adr.valueSize() == adr.getValue().size());
+        CHECK(n.personName().firstname == "John");
+        CHECK(n.personName().prefix == "Mr.");
+        n.values()[0] = "Smith";
+        CHECK(n.personName().lastname == "Smith");
+    }
+
+    SECTION("geo"){
+        vCardProperty geo(VC_GEOGRAPHIC_POSITION, "geo:37.386013,-122.082932;u=10");
+        CHECK(geo.geoPosition().latitude == 37.386013);
+        CHECK(geo.geoPosition().longitude == -122.082932);
+
+        geo.setValue("-33.8688;151.2093");
+        CHECK(geo.geoPosition().latitude == -33.8688);
+        CHECK(geo.geoPosition().longitude == 151.2093);
+
+        geo.setValue("1.000000000000000000001e1;1e-30");
+        CHECK(geo.geoPosition().latitude == 10.0);
+        CHECK(geo.geoPosition().longitude == 1e-30);
+
+        geo.setValue("37,386;-122,08");
+        CHECK_THROWS(geo.geoPosition());
+        geo.setValue("north");
+        CHECK_THROWS(geo.geoPosition());
+    }
+
+    SECTION("dates"){
+        vCardProperty bday = vCardProperty::createBirthday(1996, 4, 5);
+        CHECK(bday.getValue() == "1996-04-05");
+        const vCardDateTime& d = bday.dateTime();
+        CHECK(d.hasDate);
+        CHECK_FALSE(d.hasTime);
+        CHECK(d.year == 1996);
+        CHECK(d.month == 4);
+        CHECK(d.day == 5);
+
+        bday.setValue("--0415");
+        CHECK(bday.dateTime().year == 0);
+        CHECK(bday.dateTime().month == 4);
+        CHECK(bday.dateTime().day == 15);
+
+        vCardProperty rev(VC_REVISION, "19951031T222710Z");
+        CHECK(rev.dateTime().hasZone);
+        CHECK(rev.dateTime().toUnixTime() == 815178430);
+        rev.setValue("1995-10-31T17:27:10-05:00");
+        CHECK(rev.dateTime().zone == -300);
+        CHECK(rev.dateTime().toUnixTime() == 815178430);
+        rev.setValue("T102200");
+        CHECK_FALSE(rev.dateTime().hasDate);
+        CHECK(rev.dateTime().minute == 22);
+
+        rev.setValue("1995-13-01");
+        CHECK_THROWS(rev.dateTime());
+
+        // days are checked against the month, February 29 only in leap years
+        for(const char *valid : {"2024-02-29", "20000229", "--0229", "---31", "2023-04-30", "2023-12-31"}){
+            rev.setValue(valid);
+            CHECK_NOTHROW(rev.dateTime());
+        }
+        for(const char *invalid : {"2023-02-31", "2023-02-29", "19000229", "--0431", "--0230", "2023-06-31", "2023-01-32"}){
+            rev.setValue(invalid);
+            CHECK_THROWS(rev.dateTime());
+        }
+        rev.setValue("circa 1800");
+        CHECK_THROWS(rev.dateTime());
+    }
+
+    SECTION("telephone"){
+        vCardProperty tel(VC_TELEPHONE, "tel:+1-555-555-5555;ext=5555");
+        CHECK(tel.telephone().number == "+15555555555");
+        CHECK(tel.telephone().extension == "5555");
+        tel.setValue("+1 (555) 010-0100");
+        CHECK(tel.telephone().number == "+15550100100");
+        CHECK(tel.telephone().extension.empty());
+    }
+}
+
 TEST_CASE( "vCard", "[vcard]"){
     std::string str =
         "BEGIN:VCARD\r\n"
@@ -138,6 +320,911 @@ TEST_CASE( "vCard", "[vcard]"){
     REQUIRE(cards[0]["ADR"].values().at(vCardProperty::Region) == "LA");
 }
 
+TEST_CASE("vCard buffer reader", "[vcard]"){
+    std::string str =
+        "BEGIN:VCARD\r\n"
+        "VERSION:3.0\r\n"
+        "N:Gump;Forrest;;Mr.;\r\n"
+        "FN:Forrest G\r\n"
+        " ump\r\n"
+        "item1.EMAIL;TYPE=\"home,pref\":forrest@example.com\r\n"
+        "TEL;CELL:+1-555-0100\r\n"
+        "END:VCARD\r\n"
+        "BEGIN:VCARD\r\n"
+        "FN:Jenny\r\n"
+        "END:VCARD";
+
+    SECTION("property views"){
+        vCardPropertyRef prop;
+        TextReader::parseProperty(vCardStringRef("grp.TEL;VALUE=uri;TYPE=home:tel:+33-01-23-45-67"), prop);
+        CHECK(prop.getGroup() == "grp");
+        CHECK(prop.getName() == "TEL");
+        CHECK(prop.getValue() == "tel:+33-01-23-45-67");
+        REQUIRE(prop.params().size() == 2);
+        CHECK(prop.params()[1].getValue() == "home");
+
+        TextReader::parseProperty(vCardStringRef("ADR:;;Main Street\\;5;Town"), prop);
+        CHECK(prop.params().empty());
+        CHECK(prop.values().size() == 4);
+        CHECK(prop.toProperty().values().at(2) == "Main Street\\;5");
+    }
+    SECTION("the same result as stream reader"){
+        TextBufferReader br(str);
+        std::vector<vCard> cards = br.parseCards();
+
+        std::stringstream s(str);
+        TextReader tr(s);
+        std::vector<vCard> expected = tr.parseCards();
+
+        REQUIRE(cards.size() == 2);
+        REQUIRE(cards.size() == expected.size());
+        CHECK(cards[0].getVersion() == VC_VER_3_0);
+        CHECK(cards[0].count() == expected[0].count());
+        CHECK(cards[0]["FN"].getValue() == "Forrest Gump");
+        CHECK(cards[0]["EMAIL"].getGroup() == "item1");
+        CHECK(cards[0]["EMAIL"].params().count("TYPE") == 2);
+        CHECK(cards[0]["TEL"].params()["TYPE"] == "CELL");
+        CHECK(cards[1]["FN"].getValue() == "Jenny");
+    }
+}
+
+TEST_CASE("vCard mapped file reader", "[vcard]"){
+    const char *path = "mapped_file_test.vcf";
+    {
+        std::ofstream ofs(path, std::ios::binary);
+        ofs << "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Forrest Gump\r\nEND:VCARD\r\n"
+               "BEGIN:VCARD\r\nVERSION:4.0\r\nFN:Jenny\r\nEND:VCARD\r\n";
+    }
+
+    TextBufferReader br(std::make_shared<vCardMappedFile>(path));
+    std::vector<vCard> cards = br.parseCards();
+    std::remove(path);
+
+    REQUIRE(cards.size() == 2);
+    CHECK(cards[1]["FN"].getValue() == "Jenny");
+
+    CHECK_THROWS_AS(vCardMappedFile("not_existing_file.vcf"), std::runtime_error);
+}
+
+TEST_CASE("vCard binary properties", "[vcard]"){
+    // "Man" is "TWFu" in base64, folded by 76 octets
+    std::string encoded;
+    for(int i = 0; i < 1000; i++)
+        encoded += "TWFu";
+    std::string folded;
+    for(size_t i = 0; i < encoded.size(); i += 75)
+        folded += (i ? "\r\n " : "") + encoded.substr(i, 75);
+
+    auto data = std::make_shared<std::string>(
+        "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Forrest Gump\r\n"
+        "PHOTO;ENCODING=b;TYPE=JPEG:" + folded + "\r\n"
+        "X-CUSTOM:kept\r\n"
+        "LOGO:http://example.com/logo.png\r\n"
+        "END:VCARD\r\n");
+
+    SECTION("shared buffer is referenced"){
+        std::vector<vCard> cards = TextBufferReader(std::shared_ptr<const std::string>(data)).parseCards();
+        REQUIRE(cards.size() == 1);
+        REQUIRE(cards[0].count() == 4);
+
+        vCardProperty& photo = cards[0][VC_PHOTO];
+        REQUIRE(photo.isBlob());
+        CHECK(photo.getBlob()->source().data() >= data->data());
+        CHECK(photo.getBlob()->source().end() <= data->data() + data->size());
+        CHECK(photo.params()["ENCODING"] == "b");
+
+        std::string decoded = photo.getBinary();
+        CHECK(decoded.size() == 3000);
+        CHECK(decoded.substr(0, 6) == "ManMan");
+        CHECK(photo.isBlob());
+
+        // small values are not blobs
+        CHECK_FALSE(cards[0][VC_LOGO].isBlob());
+        CHECK(cards[0][VC_LOGO].getBinary() == "http://example.com/logo.png");
+        CHECK(cards[0]["X-CUSTOM"].getValue() == "kept");
+
+        // the text is materialized on request
+        CHECK(photo.getValue() == encoded);
+        CHECK_FALSE(photo.isBlob());
+        CHECK(photo.getBinary().size() == 3000);
+    }
+    SECTION("batch references the shared buffer"){
+        vCardBatch batch;
+        TextBufferReader(std::shared_ptr<const std::string>(data)).readBatch(batch);
+        REQUIRE(batch.size() == 1);
+        const vCardBatch::Property *photo = batch[0].find(VC_PHOTO);
+        REQUIRE(photo != nullptr);
+        REQUIRE(photo->isBlob());
+        CHECK(photo->getValue().empty());
+        CHECK(photo->getBlob()->source().data() >= data->data());
+        CHECK_FALSE(batch[0].find(VC_LOGO)->isBlob());
+
+        vCard card = batch[0].toCard();
+        CHECK(card[VC_PHOTO].isBlob());
+        CHECK(card[VC_PHOTO].getBinary().size() == 3000);
+
+        // transient source is copied into the arena
+        vCardBatch copied;
+        TextBufferReader(*data).readBatch(copied);
+        CHECK_FALSE(copied[0].find(VC_PHOTO)->isBlob());
+        CHECK(copied[0].find(VC_PHOTO)->getValue() == encoded);
+    }
+    SECTION("stream source is copied"){
+        std::stringstream s(*data);
+        std::vector<vCard> cards = TextReader(s).parseCards();
+        REQUIRE(cards.size() == 1);
+        vCardProperty photo = cards[0][VC_PHOTO];
+        REQUIRE(photo.isBlob());
+        data.reset();
+        CHECK(photo.getBinary().size() == 3000);
+
+        std::stringstream out;
+        TextWriter tw(out);
+        tw << photo;
+        std::string unfolded = out.str();
+        for(size_t pos; (pos = unfolded.find("\r\n ")) != std::string::npos;)
+            unfolded.erase(pos, 3);
+        CHECK(unfolded == "PHOTO;ENCODING=b;TYPE=JPEG:" + encoded);
+    }
+    SECTION("data URI"){
+        CHECK(vCardBlob::decodeValue("data:image/png;base64,TWFuTWE=", false) == "ManMa");
+        CHECK(vCardBlob::decodeValue("TWE", true) == "Ma");
+        CHECK_THROWS_AS(vCardBlob::decodeValue("TW*u", true), std::runtime_error);
+    }
+    SECTION("malformed base64"){
+        CHECK(vCardBlob::decodeValue("QQ==\r\n ", true) == "A");
+        CHECK(vCardBlob::decodeValue("QUI=", true) == "AB");
+        CHECK(vCardBlob::decodeValue("QQ=", true) == "A");
+        CHECK_THROWS_AS(vCardBlob::decodeValue("QQ==garbage", true), std::runtime_error);
+        CHECK_THROWS_AS(vCardBlob::decodeValue("QQ==QQ==", true), std::runtime_error);
+        CHECK_THROWS_AS(vCardBlob::decodeValue("QUI==", true), std::runtime_error);
+        CHECK_THROWS_AS(vCardBlob::decodeValue("=QQQ", true), std::runtime_error);
+        CHECK_THROWS_AS(vCardBlob::decodeValue("TWFuQ===", true), std::runtime_error);
+        CHECK_THROWS_AS(vCardBlob::decodeValue("TWFuQ", true), std::runtime_error);
+        CHECK_THROWS_AS(vCardBlob::decodeValue(std::string(40, 'A') + "Q", true), std::runtime_error);
+
+        // the padding is checked across folds of the source line
+        std::string str = "BEGIN:VCARD\r\nPHOTO;ENCODING=b:" + std::string(1200, 'A') + "QQ=\r\n =x\r\nEND:VCARD\r\n";
+        std::vector<vCard> cards = TextBufferReader(str).parseCards();
+        REQUIRE(cards.size() == 1);
+        REQUIRE(cards[0][VC_PHOTO].isBlob());
+        CHECK_THROWS_AS(cards[0][VC_PHOTO].getBinary(), std::runtime_error);
+    }
+    SECTION("base64 codec"){
+        // reference encoder, vectorized one is used for inputs longer than 28 bytes
+        auto encode = [](const std::string& data) {
+            const char *abc = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            std::string out;
+            for(size_t i = 0; i < data.size(); i += 3){
+                unsigned v = static_cast<unsigned char>(data[i]) << 16;
+                if(i + 1 < data.size()) v |= static_cast<unsigned char>(data[i + 1]) << 8;
+                if(i + 2 < data.size()) v |= static_cast<unsigned char>(data[i + 2]);
+                out += abc[v >> 18];
+                out += abc[(v >> 12) & 63];
+                out += i + 1 < data.size() ? abc[(v >> 6) & 63] : '=';
+                out += i + 2 < data.size() ? abc[v & 63] : '=';
+            }
+            return out;
+        };
+
+        unsigned seed = 1;
+        for(size_t size : {0, 1, 2, 3, 27, 28, 29, 31, 32, 33, 100, 1000, 4099}){
+            std::string data;
+            for(size_t i = 0; i < size; i++){
+                seed = seed * 1103515245 + 12345;
+                data += static_cast<char>(seed >> 16);
+            }
+
+            std::string encoded = vCardProperty::createBinary(VC_KEY, data).getBlob()->value();
+            REQUIRE(encoded == encode(data));
+            CHECK(vCardBlob::decodeValue(encoded, true) == data);
+
+            // line breaks and spaces inside of the vectorized blocks
+            std::string spaced;
+            for(size_t i = 0; i < encoded.size(); i += 45)
+                spaced += encoded.substr(i, 45) + "\r\n ";
+            CHECK(vCardBlob::decodeValue(spaced, true) == data);
+        }
+    }
+    SECTION("binary round trip"){
+        std::string data(10000, '\0');
+        for(size_t i = 0; i < data.size(); i++)
+            data[i] = static_cast<char>(i * 7);
+
+        vCard card;
+        card << vCardProperty::createBinary(VC_PHOTO, data, "JPEG");
+        auto out = std::make_shared<std::string>();
+        {
+            std::stringstream s;
+            TextWriter tw(s);
+            tw << card;
+            *out = s.str();
+        }
+        CHECK(card[VC_PHOTO].isBlob());
+
+        std::vector<vCard> cards = TextBufferReader(std::shared_ptr<const std::string>(out)).parseCards();
+        REQUIRE(cards.size() == 1);
+        vCardProperty& photo = cards[0][VC_PHOTO];
+        CHECK(photo.isBlob());
+        CHECK(photo.params()["TYPE"] == "JPEG");
+        CHECK(photo.getBinary() == data);
+    }
+}
+
+TEST_CASE("vCard line folding", "[vcard]"){
+    vCard card;
+    card << vCardProperty(VC_FORMATTED_NAME, "Forrest Gump");
+    std::string note;
+    for(int i = 0; i < 40; i++)
+        note += "Привет, 世界! ";   // 2 and 3 bytes sequences at all positions
+    card << vCardProperty(VC_NOTE, note);
+    card << vCardProperty(VC_URL, std::string(75 - 4, 'u'));
+
+    std::stringstream s;
+    TextWriter tw(s);
+    tw << card;
+    std::string out = s.str();
+    CHECK(out.find("URL:" + std::string(71, 'u') + "\r\n") != std::string::npos);   // exactly 75 octets
+
+    size_t lines = 0;
+    for(size_t pos = 0; pos < out.size(); lines++){
+        size_t end = out.find("\r\n", pos);
+        REQUIRE(end != std::string::npos);
+        CHECK(end - pos <= 75);
+        CHECK((static_cast<unsigned char>(out[pos + (out[pos] == ' ')]) & 0xC0) != 0x80);
+        pos = end + 2;
+    }
+    CHECK(lines > 10);
+
+    std::vector<vCard> cards = TextBufferReader(out).parseCards();
+    REQUIRE(cards.size() == 1);
+    CHECK(cards[0][VC_NOTE].getValue() == note);
+    CHECK(cards[0][VC_FORMATTED_NAME].getValue() == "Forrest Gump");
+}
+
+TEST_CASE("vCard output sinks", "[vcard]"){
+    std::string str =
+        "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Forrest Gump\r\nNOTE:" + std::string(200, 'n') + "\r\n"
+        "item1.EMAIL;TYPE=home:forrest@example.com\r\nEND:VCARD\r\n";
+    std::vector<vCard> cards = TextBufferReader(str).parseCards();
+    cards.insert(cards.end(), 20, cards[0]);
+
+    std::stringstream s;
+    TextWriter(s) << cards;
+    std::string expected = s.str();
+
+    std::string out;
+    {
+        vCardStringSink sink(out);
+        TextWriter(sink) << cards;
+    }
+    CHECK(out == expected);
+
+    std::vector<size_t> chunks;
+    std::string collected;
+    {
+        vCardCallbackSink sink([&](const char *data, size_t size){
+            chunks.push_back(size);
+            collected.append(data, size);
+        }, 1024);
+        TextWriter tw(sink);
+        tw << cards;
+        CHECK(collected.size() < expected.size());   // the rest is in the buffer
+    }
+    CHECK(collected == expected);
+    CHECK(chunks.size() > 2);
+
+    FILE *file = std::tmpfile();
+    REQUIRE(file);
+    {
+        vCardFdSink sink(fileno(file), 100);
+        sink.write(expected.data(), expected.size());   // bigger than the block, written directly
+        sink << "tail";
+        sink.flush();
+    }
+    std::string written(expected.size() + 4, '\0');
+    std::rewind(file);
+    CHECK(std::fread(&written[0], 1, written.size(), file) == written.size());
+    std::fclose(file);
+    CHECK(written == expected + "tail");
+
+    std::stringstream js;
+    JsonWriter(js) << cards;
+    std::string json;
+    {
+        vCardStringSink sink(json);
+        JsonWriter(sink) << cards;
+    }
+    CHECK(json == js.str());
+
+    vCardFdSink closed(-1);
+    closed << "data";
+    CHECK_THROWS_AS(closed.flush(), std::runtime_error);
+}
+
+TEST_CASE("vCard parallel writing", "[vcard]"){
+    std::string str;
+    for(int i = 0; i < 1500; i++)
+        str += "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Card " + std::to_string(i) + "\r\nN:Doe;John;;;\r\n"
+               "EMAIL;TYPE=home:john" + std::to_string(i) + "@example.com\r\nNOTE:" + std::string(i % 150, 'n') + "\r\n"
+               "END:VCARD\r\n";
+    std::vector<vCard> cards = TextBufferReader(str).parseCards();
+    REQUIRE(cards.size() == 1500);
+
+    std::stringstream text, parallel_text;
+    TextWriter(text) << cards;
+    TextWriter(parallel_text).write(cards, 4);
+    CHECK(parallel_text.str() == text.str());
+    CHECK(TextBufferReader(parallel_text.str()).parseCards().size() == 1500);
+
+    std::string chunked;
+    {
+        vCardCallbackSink sink([&chunked](const char *data, size_t size){ chunked.append(data, size); }, 4096);
+        TextWriter(sink).write(cards, 3);
+    }
+    CHECK(chunked == text.str());
+
+    std::stringstream json, parallel_json;
+    JsonWriter(json) << cards;
+    JsonWriter(parallel_json).write(cards, 4);
+    CHECK(parallel_json.str() == json.str());
+    REQUIRE_THAT(json.str(), StartsWith("[[\"vcard\""));
+    REQUIRE_THAT(json.str(), Contains("]],[\"vcard\""));
+    REQUIRE_THAT(json.str(), EndsWith("]]]"));
+
+    std::stringstream xml, parallel_xml;
+    XmlWriter(xml) << cards;
+    XmlWriter(parallel_xml).write(cards, 4);
+    CHECK(parallel_xml.str() == xml.str());
+    REQUIRE_THAT(xml.str(), EndsWith("</vcard></vcards>"));
+
+    std::stringstream utf16, parallel_utf16;
+    TextWriter(utf16, UTF_16) << cards;
+    TextWriter(parallel_utf16, UTF_16).write(cards, 4);
+    CHECK(parallel_utf16.str() == utf16.str());
+}
+
+TEST_CASE("vCard pull reader", "[vcard]"){
+    std::string str =
+        "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Forrest Gump\r\nEND:VCARD\r\n"
+        "BEGIN:VCARD\r\nFN:Jenny\r\nTEL:+1-555-0100\r\nEND:VCARD\r\n";
+
+    SECTION("stream operator"){
+        std::stringstream s(str);
+        TextReader tr(s);
+        vCard card;
+        std::vector<std::string> names;
+        while(tr >> card)
+            names.push_back(card["FN"].getValue());
+
+        REQUIRE(names.size() == 2);
+        CHECK(names[1] == "Jenny");
+        CHECK(card.count() == 0);
+    }
+    SECTION("iterators"){
+        std::stringstream s(str);
+        TextReader tr(s);
+        int count = 0;
+        for(vCard& card : tr){
+            CHECK(card.getVersion() == (count == 0 ? VC_VER_3_0 : VC_VER_4_0));
+            count++;
+        }
+        CHECK(count == 2);
+
+        TextBufferReader br(str);
+        auto it = br.begin();
+        REQUIRE(it != br.end());
+        CHECK(it->count() == 1);
+        ++it;
+        CHECK(it->count() == 2);
+        CHECK(++it == br.end());
+    }
+    SECTION("read to vector"){
+        std::stringstream s(str);
+        TextReader tr(s);
+        std::vector<vCard> cards;
+        vCard first;
+        tr >> first >> cards;
+        CHECK(first["FN"].getValue() == "Forrest Gump");
+        CHECK(cards.size() == 1);
+    }
+}
+
+TEST_CASE("vCard parallel parsing", "[vcard]"){
+    std::string str;
+    for(int i = 0; i < 3000; i++){
+        str += "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Name " + std::to_string(i) + "\r\n";
+        // folded line which looks like the end of card
+        str += "NOTE:multiline\r\n\r\n END:VCARD\r\n";
+        str += "TEL;TYPE=CELL:+1-555-" + std::to_string(i) + "\r\nEND:VCARD\r\n";
+    }
+
+    std::vector<vCard> expected = TextBufferReader(str).parseCards();
+    std::vector<vCard> cards = TextBufferReader(str).parseCards(4);
+
+    REQUIRE(expected.size() == 3000);
+    REQUIRE(cards.size() == expected.size());
+    for(size_t i = 0; i < cards.size(); i++){
+        REQUIRE(cards[i].count() == expected[i].count());
+        REQUIRE(cards[i]["FN"].getValue() == "Name " + std::to_string(i));
+    }
+
+    std::stringstream s(str);
+    TextReader tr(s);
+    CHECK(tr.parseCards(0).size() == 3000);
+}
+
+TEST_CASE("vCard line splitting", "[vcard]"){
+    std::string long_value(100000, 'x');
+    std::string str = "BEGIN:VCARD\nFN:LF only\rNOTE:CR only\r\n"
+                      "NOTE:folded with space\r\n and tab\r\n\tend\r\n"
+                      "NOTE:" + long_value + "\r\n " + long_value + "\r\n"
+                      "END:VCARD";
+
+    std::vector<std::string> expected {
+        "BEGIN:VCARD", "FN:LF only", "NOTE:CR only", "NOTE:folded with spaceand tabend",
+        "NOTE:" + long_value + long_value, "END:VCARD"
+    };
+
+    std::stringstream s(str);
+    TextReader tr(s);
+    TextBufferReader br(str);
+    vCardStringRef line;
+    for(const std::string& e : expected){
+        REQUIRE(tr.readLine(line));
+        CHECK(line == e);
+        REQUIRE(br.readLine(line));
+        CHECK(line == e);
+    }
+    CHECK_FALSE(tr.readLine(line));
+    CHECK_FALSE(br.readLine(line));
+}
+
+TEST_CASE("vCard legacy encodings", "[vcard]"){
+    std::string str =
+        "BEGIN:VCARD\r\nVERSION:2.1\r\n"
+        "N;CHARSET=SHIFT_JIS:\x93\xfa\x96\x7b;\xb1\xb2\r\n"
+        "FN;CHARSET=Windows-1251;ENCODING=QUOTED-PRINTABLE:=CF=F0=E8=E2=E5=F2\r\n"
+        "NOTE;ENCODING=QUOTED-PRINTABLE;CHARSET=UTF-8:=D0=9F=D1=80=D0=B8=\r\n=D0=B2=D0=B5=D1=82\r\n"
+        "LABEL;HOME;QUOTED-PRINTABLE:first line=0D=0A=\r\nsoft break =3D =ZZ=\r\nend\r\n"
+        "ADR;CHARSET=ISO-8859-1:;;Stra\xdf" "e 1\r\n"
+        "X-RAW;CHARSET=X-UNKNOWN:raw\r\n"
+        "END:VCARD\r\n";
+
+    auto check = [](vCard& card){
+        CHECK(card["N"].getValue() == u8"日本;ｱｲ");
+        CHECK(card["N"].params().count("CHARSET") == 0);
+        CHECK(card["FN"].getValue() == u8"Привет");
+        CHECK(card["FN"].params().count("ENCODING") == 0);
+        CHECK(card["NOTE"].getValue() == u8"Привет");
+        CHECK(card["LABEL"].getValue() == "first line\r\nsoft break = =ZZend");
+        CHECK(card["LABEL"].params().count("TYPE") == 1);
+        CHECK(card["ADR"].values()[2] == u8"Straße 1");
+        CHECK(card["X-RAW"].getValue() == "raw");
+        CHECK(card["X-RAW"].params().count("CHARSET") == 1);
+    };
+
+    std::stringstream s(str);
+    vCard card;
+    REQUIRE(TextReader(s).readCard(card));
+    check(card);
+
+    TextBufferReader br(str);
+    REQUIRE(br.readCard(card));
+    check(card);
+
+    vCardBatch batch;
+    TextBufferReader(str).readBatch(batch);
+    REQUIRE(batch.size() == 1);
+    card = batch[0].toCard();
+    check(card);
+
+    // quoted-printable value is joined with the next lines until the line without soft break
+    std::string long_text;
+    std::string encoded = "BEGIN:VCARD\r\nNOTE;ENCODING=QUOTED-PRINTABLE:";
+    for(int i = 0; i < 200; i++){
+        long_text += "line " + std::to_string(i) + " \xe9";
+        encoded += "line " + std::to_string(i) + " =E9=\r\n";
+    }
+    encoded += "\r\nEND:VCARD\r\n";
+    std::stringstream ls(encoded);
+    REQUIRE(TextReader(ls).readCard(card));
+    CHECK(card["NOTE"].getValue() == long_text);
+    CHECK(card.properties().size() == 1);
+}
+
+TEST_CASE("vCard UTF-16", "[vcard]"){
+    std::vector<vCard> cards;
+    for(int i = 0; i < 2000; i++){
+        vCard card;
+        card.addProperty(vCardProperty(VC_FORMATTED_NAME, "Contact " + std::to_string(i)));
+        card.addProperty(vCardProperty(VC_NOTE, u8"Привет, 日本 \U0001F600 " + std::string(i % 50, 'x')));
+        cards.push_back(card);
+    }
+
+    std::stringstream utf8;
+    TextWriter(utf8) << cards;
+
+    std::stringstream utf16;
+    {
+        TextWriter writer(utf16, UTF_16);
+        writer << cards;
+    }
+    std::string le = utf16.str();
+    REQUIRE(le.size() > 2);
+    CHECK(le.compare(0, 2, "\xFF\xFE") == 0);
+
+    // the same text in big endian with BOM and in little endian without BOM
+    std::string be = le;
+    for(size_t i = 0; i + 1 < be.size(); i += 2)
+        std::swap(be[i], be[i + 1]);
+    std::string le_no_bom = le.substr(2);
+
+    auto check = [&](std::vector<vCard> parsed){
+        REQUIRE(parsed.size() == cards.size());
+        for(size_t i = 0; i < cards.size(); i += 97){
+            CHECK(parsed[i][VC_FORMATTED_NAME].getValue() == cards[i][VC_FORMATTED_NAME].getValue());
+            CHECK(parsed[i][VC_NOTE].getValue() == cards[i][VC_NOTE].getValue());
+        }
+    };
+
+    for(const std::string& data : {le, be, le_no_bom}){
+        std::stringstream s(data);
+        check(TextReader(s).parseCards());
+        check(TextBufferReader(data).parseCards());
+        check(TextBufferReader(std::make_shared<const std::string>(data)).parseCards(2));
+    }
+
+    std::stringstream s(le);
+    std::vector<vCard> parsed = TextReader(s).parseCards(2);
+    check(parsed);
+    std::stringstream back;
+    TextWriter(back) << parsed;
+    CHECK(back.str() == utf8.str());
+
+    // UTF-8 BOM is skipped
+    std::string bom = "\xEF\xBB\xBF" "BEGIN:VCARD\r\nFN:BOM\r\nEND:VCARD\r\n";
+    vCard card;
+    REQUIRE(TextBufferReader(bom).readCard(card));
+    CHECK(card[VC_FORMATTED_NAME].getValue() == "BOM");
+    std::stringstream bs(bom);
+    REQUIRE(TextReader(bs).readCard(card));
+    CHECK(card[VC_FORMATTED_NAME].getValue() == "BOM");
+
+    // invalid UTF-16 is replaced
+    std::string broken("B\0E\0G\0I\0N\0:\0V\0C\0A\0R\0D\0\r\0\n\0F\0N\0:\0\x00\xD8" "a\0\r\0\n\0"
+                       "E\0N\0D\0:\0V\0C\0A\0R\0D\0", 58);
+    REQUIRE(TextBufferReader(broken).readCard(card));
+    CHECK(card[VC_FORMATTED_NAME].getValue() == u8"�a");
+}
+
+TEST_CASE("vCard diagnostics", "[vcard]"){
+    std::string str =
+        "BEGIN:VCARD\r\nFN:Name\r\nTEL;TYPE=\"home:123\r\n"
+        "NOTE:folded\r\n note\r\nno colon here\r\nEND:VCARD\r\n"
+        "garbage\r\nBEGIN:VCARD\r\nFN:Unfinished\r\n";
+
+    auto check = [&](const vCardDiagnosticList& list){
+        REQUIRE(list.items().size() == 4);
+        CHECK(list.items()[0].error == VC_PARSE_NO_COLON);     // ':' is inside of the quotes
+        CHECK(list.items()[0].line == 3);
+        CHECK(list.items()[0].offset == str.find("TEL"));
+        CHECK(list.items()[1].error == VC_PARSE_NO_COLON);
+        CHECK(list.items()[1].line == 6);
+        CHECK(list.items()[1].offset == str.find("no colon"));
+        CHECK(std::string(list.items()[1].reason()).find("':'") != std::string::npos);
+        CHECK(list.items()[2].error == VC_PARSE_OUTSIDE_CARD);
+        CHECK(list.items()[2].line == 8);
+        CHECK(list.items()[3].error == VC_PARSE_UNEXPECTED_END);
+        CHECK(list.items()[3].line == 9);
+        CHECK(list.items()[3].offset == str.rfind("BEGIN"));
+    };
+
+    vCardDiagnosticList list;
+    std::stringstream s(str);
+    TextReader tr(s);
+    tr.setDiagnostics(&list);
+    std::vector<vCard> cards = tr.parseCards();
+    REQUIRE(cards.size() == 1);
+    CHECK(cards[0].properties().size() == 2);
+    check(list);
+
+    list.clear();
+    TextBufferReader br(str);
+    br.setDiagnostics(&list);
+    CHECK(br.parseCards().size() == 1);
+    check(list);
+
+    list.clear();
+    vCardBatch batch;
+    TextBufferReader batch_reader(str);
+    batch_reader.setDiagnostics(&list);
+    CHECK(batch_reader.readBatch(batch) == 1);
+    check(list);
+
+    // positions are absolute in parallel parsing
+    std::string big;
+    for(int i = 0; i < 20000; i++)
+        big += "BEGIN:VCARD\r\nFN:Card\r\nEND:VCARD\r\n";
+    size_t lines = 20000 * 3;
+    big += str;
+    list.clear();
+    TextBufferReader pr(big);
+    pr.setDiagnostics(&list);
+    CHECK(pr.parseCards(4).size() == 20001);
+    REQUIRE(list.items().size() == 4);
+    CHECK(list.items()[0].line == lines + 3);
+    CHECK(list.items()[1].offset == big.find("no colon"));
+    CHECK(list.items()[3].line == lines + 9);
+
+    // status codes instead of exceptions
+    vCardPropertyRef prop;
+    CHECK(TextReader::tryParseProperty(vCardStringRef("no colon"), prop) == VC_PARSE_NO_COLON);
+    CHECK(TextReader::tryParseProperty(vCardStringRef("FN:ok"), prop) == VC_PARSE_OK);
+    CHECK(prop.getValue() == "ok");
+    std::vector<vCardParamRef> params;
+    CHECK(TextReader::tryParseParams(vCardStringRef("TYPE=home;LABEL=\"x"), params) == VC_PARSE_UNCLOSED_QUOTE);
+}
+
+TEST_CASE("vCard push parser", "[vcard]"){
+    std::string str =
+        "\xEF\xBB\xBF" "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Forrest Gump\r\n"
+        "NOTE:folded\r\n  note\r\n\tend\r\nEND:VCARD\r\n"
+        "BEGIN:VCARD\nFN:LF only\nNOTE;ENCODING=QUOTED-PRINTABLE:soft=\r\nbreak\rEND:VCARD\r\n"
+        "BEGIN:VCARD\r\nFN:No line end\r\nEND:VCARD";
+
+    std::vector<vCard> expected = TextBufferReader(str).parseCards();
+    REQUIRE(expected.size() == 3);
+
+    auto same = [&](std::vector<vCard>& cards){
+        REQUIRE(cards.size() == expected.size());
+        for(size_t i = 0; i < cards.size(); i++){
+            REQUIRE(cards[i].properties().size() == expected[i].properties().size());
+            for(size_t k = 0; k < cards[i].properties().size(); k++){
+                CHECK(cards[i].properties()[k].getName() == expected[i].properties()[k].getName());
+                CHECK(cards[i].properties()[k].getValue() == expected[i].properties()[k].getValue());
+            }
+        }
+    };
+
+    // every split position, also inside of CRLF and folds
+    TextPushParser parser;
+    for(size_t split = 0; split <= str.size(); split++){
+        std::vector<vCard> cards;
+        parser.feed(str.data(), split, cards);
+        parser.feed(str.data() + split, str.size() - split, cards);
+        CHECK(parser.finish(cards) == 1);
+        same(cards);
+    }
+
+    // byte by byte, the last card is completed only by finish()
+    std::vector<vCard> cards;
+    size_t count = 0;
+    for(char c : str)
+        count += parser.feed(&c, 1, cards);
+    CHECK(count == 2);
+    CHECK(parser.buffered() == std::string("END:VCARD").size());
+    parser.finish(cards);
+    same(cards);
+    CHECK(parser.buffered() == 0);
+
+    // builder receives cards spanning chunks
+    vCardBatch batch;
+    for(size_t pos = 0; pos < str.size(); pos += 7)
+        parser.feed(str.data() + pos, std::min<size_t>(7, str.size() - pos), batch);
+    parser.finish(batch);
+    REQUIRE(batch.size() == 3);
+    CHECK(batch[0].find("NOTE")->getValue() == "folded note" "end");
+
+    // long folded line fed by small chunks
+    std::string photo = "BEGIN:VCARD\r\nPHOTO;ENCODING=b:";
+    for(int i = 0; i < 20000; i++)
+        photo += "QUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFBQUFB\r\n ";
+    photo += "QUFB\r\nEND:VCARD\r\n";
+    cards.clear();
+    for(size_t pos = 0; pos < photo.size(); pos += 3)
+        parser.feed(photo.data() + pos, std::min<size_t>(3, photo.size() - pos), cards);
+    REQUIRE(cards.size() == 1);     // END line completes the card without finish()
+    parser.finish(cards);
+    CHECK(cards[0][VC_PHOTO].getBinary().size() == 20000 * 54 + 3);
+
+    // positions in diagnostics are counted over all chunks
+    vCardDiagnosticList list;
+    parser.setDiagnostics(&list);
+    std::string broken = "BEGIN:VCARD\r\nFN:x\r\nbroken\r\nEND:VCARD\r\n";
+    cards.clear();
+    parser.feed(broken.data(), 20, cards);
+    parser.feed(broken.data() + 20, broken.size() - 20, cards);
+    parser.finish(cards);
+    CHECK(cards.size() == 1);
+    REQUIRE(list.items().size() == 1);
+    CHECK(list.items()[0].line == 3);
+    CHECK(list.items()[0].offset == broken.find("broken"));
+
+    // the chunk ends between CR and LF of the END line, LF is not an extra line
+    std::string two = broken + broken;
+    size_t cr = broken.size() - 1;
+    list.clear();
+    cards.clear();
+    CHECK(parser.feed(two.data(), cr, cards) == 1);
+    parser.feed(two.data() + cr, two.size() - cr, cards);
+    parser.finish(cards);
+    CHECK(cards.size() == 2);
+    REQUIRE(list.items().size() == 2);
+    CHECK(list.items()[1].line == 7);
+    CHECK(list.items()[1].offset == broken.size() + broken.find("broken"));
+}
+
+TEST_CASE("vCard event handler", "[vcard]"){
+    std::string str =
+        "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Forrest Gump\r\nN:Gump;Forrest;;Mr.;\r\n"
+        "item1.EMAIL;TYPE=home,pref:forrest@example.com\r\nEND:VCARD\r\n"
+        "garbage\r\nBEGIN:VCARD\r\nFN:Jenny\r\nEND:VCARD\r\n";
+
+    struct Handler : vCardHandler {
+        std::vector<std::string> events;
+
+        void onBeginCard() override { events.push_back("begin"); }
+        void onVersion(vCardVersion version) override { events.push_back(version == VC_VER_3_0 ? "3.0" : "?"); }
+        void onProperty(vCardStringRef group, vCardStringRef name,
+                        const std::vector<vCardParamRef>& params, const std::vector<vCardStringRef>& values) override {
+            std::string e = group.str() + "." + name.str() + ":" + std::to_string(params.size());
+            for(vCardStringRef v : values)
+                e += "|" + v.str();
+            events.push_back(e);
+        }
+        void onEndCard() override { events.push_back("end"); }
+    };
+
+    std::vector<std::string> expected {
+        "begin", "3.0", ".FN:0|Forrest Gump", ".N:0|Gump|Forrest||Mr.|", "item1.EMAIL:2|forrest@example.com", "end",
+        "begin", ".FN:0|Jenny", "end"
+    };
+
+    Handler h1;
+    CHECK(TextBufferReader(str).parse(h1) == 2);
+    CHECK(h1.events == expected);
+
+    Handler h2;
+    std::stringstream s(str);
+    CHECK(TextReader(s).parse(h2) == 2);
+    CHECK(h2.events == expected);
+
+    Handler h3;
+    TextPushParser parser;
+    parser.feed(str.data(), 50, h3);
+    parser.feed(str.data() + 50, str.size() - 50, h3);
+    parser.finish(h3);
+    CHECK(h3.events == expected);
+}
+
+TEST_CASE("vCard projection", "[vcard]"){
+    std::string str =
+        "BEGIN:VCARD\r\nVERSION:2.1\r\nFN:Forrest Gump\r\nNOTE:long\r\n note\r\n"
+        "item1.EMAIL;TYPE=home:forrest@example.com\r\nX-BROKEN;TYPE=\"not closed\r\n"
+        "LABEL;ENCODING=QUOTED-PRINTABLE:first=\r\nTEL:not a property\r\n"
+        "tel;CELL:+1 555 0100\r\nEND:VCARD\r\n";
+
+    std::vector<std::string> fields {VC_FORMATTED_NAME, VC_EMAIL, VC_TELEPHONE};
+    auto check = [](std::vector<vCard> cards){
+        REQUIRE(cards.size() == 1);
+        CHECK(cards[0].getVersion() == VC_VER_2_1);
+        REQUIRE(cards[0].properties().size() == 3);
+        CHECK(cards[0][VC_FORMATTED_NAME].getValue() == "Forrest Gump");
+        CHECK(cards[0][VC_EMAIL].getGroup() == "item1");
+        CHECK(cards[0].properties().back().getValue() == "+1 555 0100");    // names are case-insensitive
+        CHECK(cards[0].getProperties(VC_NOTE).empty());
+    };
+
+    std::stringstream s(str);
+    TextReader tr(s);
+    tr.setProjection(fields);
+    check(tr.parseCards());
+
+    TextBufferReader br(str);
+    vCardDiagnosticList list;
+    br.setDiagnostics(&list);
+    br.setProjection(fields);
+    check(br.parseCards());
+    CHECK(list.empty());    // skipped lines are not validated
+
+    std::string many;
+    for(int i = 0; i < 5000; i++)
+        many += str;
+    TextBufferReader pr(many);
+    pr.setProjection(fields);
+    std::vector<vCard> cards = pr.parseCards(4);
+    REQUIRE(cards.size() == 5000);
+    check(std::vector<vCard>(cards.end() - 1, cards.end()));
+
+    TextPushParser parser;
+    parser.setProjection(fields);
+    cards.clear();
+    parser.feed(str.data(), str.size(), cards);
+    check(cards);
+}
+
+TEST_CASE("vCard property dispatch", "[vcard]"){
+    std::string str =
+        "BEGIN:VCARD\r\nversion:3.0\r\nNOTE:VERSION:2.1 PHOTO END:VCARD\r\n"
+        "X-SECRET:hidden\r\nx-skype;TYPE=work:forrest\r\nX-OTHER:kept\r\nEND:VCARD\r\n";
+
+    struct Filter : vCardExtensionHandler {
+        size_t calls = 0;
+        bool onExtension(const vCardPropertyRef& prop) override {
+            calls++;
+            return prop.getValue() != "hidden";
+        }
+    };
+
+    Filter filter;
+    TextBufferReader br(str);
+    br.setExtensionHandler("X-SECRET", &filter);
+    br.setExtensionHandler("X-SKYPE", &filter);
+    std::vector<vCard> cards = br.parseCards();
+    REQUIRE(cards.size() == 1);
+    CHECK(cards[0].getVersion() == VC_VER_3_0);
+    REQUIRE(cards[0].properties().size() == 3);
+    CHECK(cards[0][VC_NOTE].getValue() == "VERSION:2.1 PHOTO END:VCARD");
+    CHECK(cards[0].properties()[1].getName() == "x-skype");
+    CHECK(cards[0].properties()[2].getValue() == "kept");
+    CHECK(filter.calls == 2);
+
+    br.setExtensionHandler("X-SECRET", nullptr);
+    std::stringstream s(str);
+    TextReader tr(s);
+    tr.setExtensionHandler("X-SECRET", &filter);
+    CHECK(tr.parseCards()[0].properties().size() == 3);
+    CHECK(filter.calls == 3);
+
+    CHECK_THROWS(br.setExtensionHandler(VC_NOTE, &filter));
+}
+
+TEST_CASE("vCard batch", "[vcard]"){
+    std::string str =
+        "BEGIN:VCARD\r\nVERSION:3.0\r\nFN:Forrest Gump\r\n"
+        "item1.EMAIL;TYPE=home,pref:forrest@example.com\r\nEND:VCARD\r\n"
+        "BEGIN:VCARD\r\nFN:Jenny\r\nNOTE:folded\r\n  note\r\nEND:VCARD\r\n";
+
+    vCardBatch batch;
+    {
+        std::stringstream s(str);
+        TextReader tr(s);
+        CHECK(tr.readBatch(batch, 1) == 1);
+        CHECK(tr.readBatch(batch) == 1);
+    }
+
+    // the batch does not depend on the reader's buffers
+    REQUIRE(batch.size() == 2);
+    CHECK(batch[0].getVersion() == VC_VER_3_0);
+    REQUIRE(batch[0].find("EMAIL") != nullptr);
+    CHECK(batch[0].find("EMAIL")->getGroup() == "item1");
+    CHECK(batch[0].find("EMAIL")->params().size() == 2);
+    CHECK(batch[0].find("TEL") == nullptr);
+    CHECK(batch[1].find("NOTE")->getValue() == "folded note");
+    CHECK(batch.arena().capacity() > 0);
+
+    std::vector<vCard> cards = batch.toCards();
+    REQUIRE(cards.size() == 2);
+    CHECK(cards[0]["EMAIL"].params().count("TYPE") == 2);
+    CHECK(cards[1].getVersion() == VC_VER_4_0);
+
+    batch.clear();
+    CHECK(batch.empty());
+    CHECK(batch.arena().capacity() == 0);
+
+    TextBufferReader br(str);
+    CHECK(br.readBatch(batch) == 2);
+
+    vCardArena arena(16);
+    for(int i = 0; i < 100; i++){
+        vCardStringRef copy = arena.copy(vCardStringRef("value"));
+        REQUIRE(copy == "value");
+    }
+    int *numbers = arena.allocate<int>(1000);
+    CHECK(reinterpret_cast<uintptr_t>(numbers) % alignof(int) == 0);
+}
+
 TEST_CASE("vCard object", "[vcard]"){
     vCardParamMap params;
     params.addParam("TYPE", "home");
@@ -157,6 +1244,57 @@ TEST_CASE("vCard object", "[vcard]"){
     REQUIRE_THAT(s.str(), StartsWith("BEGIN:VCARD"));
 }
 
+TEST_CASE("vCard property index", "[vcard]"){
+    vCard card;
+    card << vCardProperty(VC_FORMATTED_NAME, "John Doe") << vCardProperty(VC_TELEPHONE, "1")
+         << vCardProperty(VC_EMAIL, "a@example.com") << vCardProperty(VC_TELEPHONE, "2");
+
+    // the first lookup builds the index
+    CHECK(card[VC_FORMATTED_NAME].getValue() == "John Doe");
+    vCardPropertySet tels = card.getProperties(VC_TELEPHONE);
+    REQUIRE(tels.size() == 2);
+    CHECK(tels.front().getValue() == "1");
+
+    // added properties are indexed incrementally, more than the initial table size
+    for(int i = 3; i <= 40; i++)
+        card.addProperty(vCardProperty(VC_TELEPHONE, std::to_string(i)));
+    card << vCardProperty("X-INDEX-TEST", "x");
+
+    tels = card.getProperties(VC_TELEPHONE);
+    REQUIRE(tels.size() == 40);
+    int expected = 1;
+    for(vCardProperty& p : tels)
+        CHECK(p.getValue() == std::to_string(expected++));
+    CHECK(card["X-INDEX-TEST"].getValue() == "x");
+
+    // removal shifts positions, the index is rebuilt
+    card.removeProperty(VC_TELEPHONE);
+    CHECK(card.getProperties(VC_TELEPHONE).empty());
+    CHECK(card[VC_EMAIL].getValue() == "a@example.com");
+    CHECK(card["X-INDEX-TEST"].getValue() == "x");
+    CHECK(card.getProperties("X-NEVER-USED-PROPERTY").empty());
+
+    // direct changes through properties() drop the index
+    card.properties().push_back(vCardProperty(VC_EMAIL, "b@example.com"));
+    vCardPropertySet emails = card.getProperties(VC_EMAIL);
+    REQUIRE(emails.size() == 2);
+    CHECK((++emails.begin())->getValue() == "b@example.com");
+
+    // the reference is kept and changed after the index was built
+    std::vector<vCardProperty>& props = card.properties();
+    CHECK(card[VC_FORMATTED_NAME].getValue() == "John Doe");
+    props.erase(props.begin());
+    CHECK_THROWS_AS(card[VC_FORMATTED_NAME], std::runtime_error);
+    CHECK(card[VC_EMAIL].getValue() == "a@example.com");
+    props.erase(props.begin());
+    props.push_back(vCardProperty(VC_TELEPHONE, "3"));
+    CHECK(card.getProperties(VC_EMAIL).size() == 1);
+    CHECK(card[VC_EMAIL].getValue() == "b@example.com");
+    CHECK(card[VC_TELEPHONE].getValue() == "3");
+    props.clear();
+    CHECK(card.getProperties(VC_EMAIL).empty());
+}
+
 //======================================================================================
 
 TEST_CASE("xCard parsing", "[xcard]"){
@@ -230,3 +1368,62 @@ TEST_CASE("jCard generate", "[jcard]") {
 
     REQUIRE_THAT(s.str(), Contains("[\"adr\", {}, \"text\", ["));
 }
+
+TEST_CASE("jCard values", "[jcard]") {
+    std::string str =
+        "BEGIN:VCARD\r\nVERSION:3.0\r\n"
+        "N:Stevenson;John;Philip,Paul;Dr.;Jr.,M.D.\r\n"
+        "item1.NOTE;LANGUAGE=en:He said \"hi\"\\nthen\\, left \\\\o/\t\x01\r\n"
+        "CATEGORIES:work,friends\r\n"
+        "TEL;TYPE=cell;TYPE=voice:+1 555 0100\r\n"
+        "TEL;VALUE=uri:tel:+1-555-0101\r\n"
+        "BDAY:1985-04-12\r\n"
+        "PHOTO;ENCODING=b;TYPE=JPEG:TWFu\r\n"
+        "END:VCARD\r\n";
+    std::vector<vCard> cards = TextBufferReader(str).parseCards();
+    REQUIRE(cards.size() == 1);
+
+    std::stringstream s;
+    JsonWriter(s) << cards[0];
+    CHECK(s.str() ==
+        "[\"vcard\", [[\"version\", {}, \"text\", \"3.0\"], "
+        "[\"n\", {}, \"text\", [\"Stevenson\", \"John\", [\"Philip\", \"Paul\"], \"Dr.\", [\"Jr.\", \"M.D.\"]]], "
+        "[\"note\", {\"group\": \"item1\", \"language\": \"en\"}, \"text\", \"He said \\\"hi\\\"\\nthen, left \\\\o/\\t\\u0001\"], "
+        "[\"categories\", {}, \"text\", \"work\", \"friends\"], "
+        "[\"tel\", {\"type\": [\"cell\", \"voice\"]}, \"text\", \"+1 555 0100\"], "
+        "[\"tel\", {}, \"uri\", \"tel:+1-555-0101\"], "
+        "[\"bday\", {}, \"date-and-or-time\", \"1985-04-12\"], "
+        "[\"photo\", {}, \"uri\", \"data:image/jpeg;base64,TWFu\"]]]");
+
+    // runs of all lengths around the vector blocks
+    auto reference = [](const std::string& v) {
+        std::string out = "\"";
+        for(unsigned char c : v){
+            char hex[8];
+            if(c == '"' || c == '\\')
+                out += std::string("\\") + static_cast<char>(c);
+            else if(c == '\n')
+                out += "\\n";
+            else if(c < 0x20){
+                std::snprintf(hex, sizeof(hex), "\\u%04x", c);
+                out += hex;
+            }
+            else
+                out += static_cast<char>(c);
+        }
+        return out + "\"";
+    };
+    for(size_t size : {1, 15, 16, 17, 31, 32, 33, 64, 100}){
+        for(size_t pos = 0; pos < size; pos += 7){
+            for(char special : {'"', '\\', '\n', '\x1f', '\x7f'}){
+                std::string value(size, 'x');
+                value[size - 1] = '\xd0';   // not special
+                value[pos] = special;
+                vCardProperty note(VC_URL, value);
+                std::stringstream js;
+                JsonWriter(js) << note;
+                CHECK(js.str() == "[\"url\", {}, \"text\", " + reference(value) + "]");
+            }
+        }
+    }
+}
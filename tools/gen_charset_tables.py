@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+#
+# Generates src/charset_tables.cpp: tables of legacy charsets for transcoding to UTF-8.
+# Usage: python3 tools/gen_charset_tables.py > src/charset_tables.cpp
+
+import codecs
+import os
+
+ROOT = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+LICENSE = open(os.path.join(ROOT, 'src', 'vcard.cpp')).read().split('*/')[0] + '*/'
+
+# codec name, normalized names (uppercase without '-' and '_')
+SINGLE_BYTE = [
+    ('cp1250', ['WINDOWS1250', 'CP1250']),
+    ('cp1251', ['WINDOWS1251', 'CP1251']),
+    ('cp1252', ['WINDOWS1252', 'CP1252']),
+    ('cp1253', ['WINDOWS1253', 'CP1253']),
+    ('cp1254', ['WINDOWS1254', 'CP1254']),
+    ('cp1255', ['WINDOWS1255', 'CP1255']),
+    ('cp1256', ['WINDOWS1256', 'CP1256']),
+    ('cp1257', ['WINDOWS1257', 'CP1257']),
+    ('cp1258', ['WINDOWS1258', 'CP1258']),
+    ('iso8859_1', ['ISO88591', 'LATIN1']),
+    ('iso8859_2', ['ISO88592', 'LATIN2']),
+    ('iso8859_3', ['ISO88593', 'LATIN3']),
+    ('iso8859_4', ['ISO88594', 'LATIN4']),
+    ('iso8859_5', ['ISO88595']),
+    ('iso8859_6', ['ISO88596']),
+    ('iso8859_7', ['ISO88597']),
+    ('iso8859_8', ['ISO88598']),
+    ('iso8859_9', ['ISO88599', 'LATIN5']),
+    ('iso8859_10', ['ISO885910', 'LATIN6']),
+    ('iso8859_11', ['ISO885911']),
+    ('iso8859_13', ['ISO885913', 'LATIN7']),
+    ('iso8859_14', ['ISO885914', 'LATIN8']),
+    ('iso8859_15', ['ISO885915', 'LATIN9']),
+    ('iso8859_16', ['ISO885916', 'LATIN10']),
+    ('koi8_r', ['KOI8R']),
+    ('koi8_u', ['KOI8U']),
+    ('cp866', ['CP866', 'IBM866']),
+]
+
+# lead bytes of Shift-JIS (CP932) double byte characters and the range of trail bytes
+SJIS_LEADS = list(range(0x81, 0xA0)) + list(range(0xE0, 0xFD))
+SJIS_TRAIL_FIRST, SJIS_TRAIL_LAST = 0x40, 0xFC
+
+
+def decode(codec, data):
+    try:
+        s = codecs.decode(data, codec)
+        return ord(s) if len(s) == 1 else 0xFFFD
+    except UnicodeDecodeError:
+        return 0xFFFD
+
+
+def table(values, per_line=12):
+    lines = []
+    for i in range(0, len(values), per_line):
+        lines.append('    ' + ', '.join('0x%04X' % v for v in values[i:i + per_line]) + ',')
+    return '\n'.join(lines)
+
+
+def main():
+    print(LICENSE)
+    print()
+    print('// Generated by tools/gen_charset_tables.py, do not edit.')
+    print()
+    print('#include "charset_tables.h"')
+    print()
+    print('namespace {')
+    print()
+    for codec, _ in SINGLE_BYTE:
+        print('const uint16_t %s_high[128] = {' % codec)
+        print(table([decode(codec, bytes([b])) for b in range(0x80, 0x100)]))
+        print('};')
+        print()
+    print('} // namespace')
+    print()
+    print('const SingleByteCharset single_byte_charsets[] = {')
+    for codec, names in SINGLE_BYTE:
+        for name in names:
+            print('    {"%s", %s_high},' % (name, codec))
+    print('};')
+    print()
+    print('const size_t single_byte_charsets_count = sizeof(single_byte_charsets) / sizeof(single_byte_charsets[0]);')
+    print()
+
+    lead_index = [0xFF] * 256
+    for i, lead in enumerate(SJIS_LEADS):
+        lead_index[lead] = i
+    print('const uint8_t sjis_lead_index[256] = {')
+    print('\n'.join('    ' + ', '.join('%d' % v for v in lead_index[i:i + 16]) + ',' for i in range(0, 256, 16)))
+    print('};')
+    print()
+    trails = SJIS_TRAIL_LAST - SJIS_TRAIL_FIRST + 1
+    values = []
+    for lead in SJIS_LEADS:
+        for trail in range(SJIS_TRAIL_FIRST, SJIS_TRAIL_LAST + 1):
+            values.append(decode('cp932', bytes([lead, trail])))
+    print('const uint16_t sjis_table[%d * %d] = {' % (len(SJIS_LEADS), trails))
+    print(table(values))
+    print('};')
+
+
+main()